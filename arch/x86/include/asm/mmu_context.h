@@ -39,6 +39,8 @@ static inline void switch_mm(struct mm_struct *prev, struct mm_struct *next,
 #ifdef CONFIG_SMP
 		percpu_write(cpu_tlbstate.state, TLBSTATE_OK);
 		percpu_write(cpu_tlbstate.active_mm, next);
+		/* the cr3 reload below flushes the tlb anyway */
+		percpu_write(cpu_tlbstate.flush_pending, 0);
 #endif
 		cpumask_set_cpu(cpu, mm_cpumask(next));
 
@@ -66,6 +68,14 @@ static inline void switch_mm(struct mm_struct *prev, struct mm_struct *next,
 			 */
 			load_cr3(next->pgd);
 			load_LDT_nolock(&next->context);
+		} else if (percpu_read(cpu_tlbstate.flush_pending)) {
+			/* A batched flush skipped us while we were lazy.
+			 * The atomic test_and_set above orders setting
+			 * TLBSTATE_OK against reading flush_pending, see
+			 * tlb_defer_lazy_flush().
+			 */
+			percpu_write(cpu_tlbstate.flush_pending, 0);
+			local_flush_tlb();
 		}
 	}
 #endif
@@ -77,7 +77,10 @@ static inline void __flush_tlb_one(unsigned long addr)
  *  - flush_tlb_page(vma, vmaddr) flushes one page
  *  - flush_tlb_range(vma, start, end) flushes a range of pages
  *  - flush_tlb_kernel_range(start, end) flushes a range of kernel pages
- *  - flush_tlb_others(cpumask, mm, va) flushes TLBs on other cpus
+ *  - flush_tlb_others(cpumask, mm, va) flushes TLBs on other cpus,
+ *    a NULL mm flushes whatever mm the other cpus are running
+ *  - flush_tlb_batched(cpumask) flushes all user TLB entries on the
+ *    given cpus, skipping those in lazy tlb mode
  *
  * ..but the i386 has somewhat limited tlb flushing capabilities,
  * and page-granular flushes are available only on i486 and up.
@@ -133,6 +136,7 @@ extern void flush_tlb_all(void);
 extern void flush_tlb_current_task(void);
 extern void flush_tlb_mm(struct mm_struct *);
 extern void flush_tlb_page(struct vm_area_struct *, unsigned long);
+extern void flush_tlb_batched(struct cpumask *cpumask);
 
 #define flush_tlb()	flush_tlb_current_task()
 
@@ -151,6 +155,7 @@ void native_flush_tlb_others(const struct cpumask *cpumask,
 struct tlb_state {
 	struct mm_struct *active_mm;
 	int state;
+	int flush_pending;	/* flush skipped while in lazy tlb mode */
 };
 DECLARE_PER_CPU_SHARED_ALIGNED(struct tlb_state, cpu_tlbstate);
 
@@ -158,6 +163,7 @@ static inline void reset_lazy_tlbstate(void)
 {
 	percpu_write(cpu_tlbstate.state, 0);
 	percpu_write(cpu_tlbstate.active_mm, &init_mm);
+	percpu_write(cpu_tlbstate.flush_pending, 0);
 }
 
 #endif	/* SMP */
@@ -6,6 +6,8 @@
 #include <linux/interrupt.h>
 #include <linux/module.h>
 #include <linux/cpu.h>
+#include <linux/sched.h>
+#include <linux/vmstat.h>
 
 #include <asm/tlbflush.h>
 #include <asm/mmu_context.h>
@@ -14,7 +16,7 @@
 #include <asm/uv/uv.h>
 
 DEFINE_PER_CPU_SHARED_ALIGNED(struct tlb_state, cpu_tlbstate)
-			= { &init_mm, 0, };
+			= { &init_mm, 0, 0, };
 
 /*
  *	Smarter SMP flushing macros.
@@ -55,6 +57,9 @@ static union smp_flush_state flush_state[NUM_INVALIDATE_TLB_VECTORS];
 
 static DEFINE_PER_CPU_READ_MOSTLY(int, tlb_vector_offset);
 
+/* Nanoseconds spent in flush IPIs not yet accounted in whole usecs */
+static DEFINE_PER_CPU(u64, tlb_flush_nsecs);
+
 /*
  * We cannot call mmdrop() because we are in interrupt context,
  * instead update mm->cpu_vm_mask.
@@ -152,7 +157,9 @@ void smp_invalidate_interrupt(struct pt_regs *regs)
 		 * BUG();
 		 */
 
-	if (f->flush_mm == percpu_read(cpu_tlbstate.active_mm)) {
+	/* A NULL flush_mm comes from flush_tlb_batched(): flush any mm */
+	if (!f->flush_mm ||
+	    f->flush_mm == percpu_read(cpu_tlbstate.active_mm)) {
 		if (percpu_read(cpu_tlbstate.state) == TLBSTATE_OK) {
 			if (f->flush_va == TLB_FLUSH_ALL)
 				local_flush_tlb();
@@ -167,6 +174,7 @@ out:
 	cpumask_clear_cpu(cpu, to_cpumask(f->flush_cpumask));
 	smp_mb__after_clear_bit();
 	inc_irq_stat(irq_tlb_count);
+	count_vm_event(TLB_REMOTE_FLUSH_RECEIVED);
 }
 
 static void flush_tlb_others_ipi(const struct cpumask *cpumask,
@@ -205,9 +213,24 @@ static void flush_tlb_others_ipi(const struct cpumask *cpumask,
 	raw_spin_unlock(&f->tlbstate_lock);
 }
 
+static void account_tlb_flush(u64 start)
+{
+	u64 nsecs;
+	u32 rem;
+
+	/* Caller has disabled preemption */
+	nsecs = __this_cpu_read(tlb_flush_nsecs) + local_clock() - start;
+	rem = do_div(nsecs, NSEC_PER_USEC);
+	__this_cpu_write(tlb_flush_nsecs, rem);
+	count_vm_event(TLB_REMOTE_FLUSH);
+	count_vm_events(TLB_REMOTE_FLUSH_USECS, nsecs);
+}
+
 void native_flush_tlb_others(const struct cpumask *cpumask,
 			     struct mm_struct *mm, unsigned long va)
 {
+	u64 start = local_clock();
+
 	if (is_uv_system()) {
 		unsigned int cpu;
 
@@ -215,10 +238,12 @@ void native_flush_tlb_others(const struct cpumask *cpumask,
 		cpumask = uv_flush_tlb_others(cpumask, mm, va, cpu);
 		if (cpumask)
 			flush_tlb_others_ipi(cpumask, mm, va);
+		account_tlb_flush(start);
 		put_cpu();
 		return;
 	}
 	flush_tlb_others_ipi(cpumask, mm, va);
+	account_tlb_flush(start);
 }
 
 static void __cpuinit calculate_tlb_offset(void)
@@ -323,6 +348,66 @@ void flush_tlb_page(struct vm_area_struct *vma, unsigned long va)
 	preempt_enable();
 }
 
+/*
+ * A cpu in lazy tlb mode runs a kernel thread on the page tables of
+ * the last user mm and never accesses user addresses through them.
+ * Instead of interrupting it, leave a note that makes switch_mm()
+ * flush the tlb before user space runs on that mm again.
+ *
+ * The note is written before the state is checked, while switch_mm()
+ * sets TLBSTATE_OK before it reads the note, so either the cpu sees
+ * the note or we see it leave lazy mode and send the IPI after all.
+ */
+static bool tlb_defer_lazy_flush(int cpu)
+{
+	struct tlb_state *ts = &per_cpu(cpu_tlbstate, cpu);
+
+	if (ts->state != TLBSTATE_LAZY)
+		return false;
+
+	ts->flush_pending = 1;
+	smp_mb();
+	return ACCESS_ONCE(ts->state) == TLBSTATE_LAZY;
+}
+
+/**
+ * flush_tlb_batched - flush the tlbs of a batch of unmapped pages
+ * @cpumask: cpus that may have cached the unmapped translations
+ *
+ * Used by page reclaim, which unmaps pages from many mms and flushes
+ * them all at once.  The translations of all user mms are flushed on
+ * the cpus in @cpumask, except on those in lazy tlb mode, which get
+ * to flush when they switch back to user space.  This is only safe
+ * because reclaim does not free page tables: a lazy cpu may still
+ * walk the ones it has loaded.
+ */
+void flush_tlb_batched(struct cpumask *cpumask)
+{
+	int cpu, this_cpu;
+
+	this_cpu = get_cpu();
+
+	if (cpumask_test_cpu(this_cpu, cpumask)) {
+		if (current->mm)
+			local_flush_tlb();
+		else
+			percpu_write(cpu_tlbstate.flush_pending, 1);
+		cpumask_clear_cpu(this_cpu, cpumask);
+	}
+
+	for_each_cpu(cpu, cpumask) {
+		if (tlb_defer_lazy_flush(cpu)) {
+			cpumask_clear_cpu(cpu, cpumask);
+			count_vm_event(TLB_LAZY_DEFERRED);
+		}
+	}
+
+	if (!cpumask_empty(cpumask))
+		flush_tlb_others(cpumask, NULL, TLB_FLUSH_ALL);
+
+	put_cpu();
+}
+
 static void do_flush_tlb_all(void *info)
 {
 	__flush_tlb_all();
@@ -27,11 +27,15 @@
 #include <linux/writeback.h>
 #include <linux/task_io_accounting_ops.h>
 #include <linux/fault-inject.h>
+#include <linux/list_sort.h>
+#include <linux/percpu.h>
+#include <linux/blk-mq.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/block.h>
 
 #include "blk.h"
+#include "blk-mq.h"
 
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_remap);
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_rq_remap);
@@ -54,7 +58,7 @@ struct kmem_cache *blk_requestq_cachep;
  */
 static struct workqueue_struct *kblockd_workqueue;
 
-static void drive_stat_acct(struct request *rq, int new_io)
+void drive_stat_acct(struct request *rq, int new_io)
 {
 	struct hd_struct *part;
 	int rw = rq_data_dir(rq);
@@ -67,6 +71,9 @@ static void drive_stat_acct(struct request *rq, int new_io)
 
 	if (!new_io) {
 		part = rq->part;
+		/* Requests on a plug list are not accounted in flight yet */
+		if (!part)
+			part = disk_map_sector_rcu(rq->rq_disk, blk_rq_pos(rq));
 		part_stat_inc(cpu, part, merges[rw]);
 	} else {
 		part = disk_map_sector_rcu(rq->rq_disk, blk_rq_pos(rq));
@@ -397,6 +404,9 @@ void blk_sync_queue(struct request_queue *q)
 	del_timer_sync(&q->timeout);
 	cancel_work_sync(&q->unplug_work);
 	throtl_shutdown_timer_wq(q);
+
+	if (q->mq_ops)
+		blk_mq_sync_queue(q);
 }
 EXPORT_SYMBOL(blk_sync_queue);
 
@@ -452,6 +462,119 @@ void blk_run_queue(struct request_queue *q)
 }
 EXPORT_SYMBOL(blk_run_queue);
 
+DEFINE_PER_CPU(struct request_queue *, blk_poll_queue);
+
+/**
+ * blk_poll - spin on a queue's completions instead of sleeping
+ * @q:	The queue the caller has synchronous I/O outstanding on
+ *
+ * Description:
+ *    Called by a task that has set its state to sleep until its I/O
+ *    completes.  If @q has a poll function and polling is enabled, the
+ *    driver's completion queue is polled until a completion turns up,
+ *    the task is woken by other means or it has to reschedule.
+ *
+ *    Returns true if the caller should recheck its wait condition, false
+ *    if it should go to sleep as usual.
+ */
+bool blk_poll(struct request_queue *q)
+{
+	long state = current->state;
+	bool found = false;
+	u64 start;
+
+	if (!q->poll_fn || !blk_queue_poll(q))
+		return false;
+
+	/* There is nothing to find while the I/O sits on our plug */
+	blk_flush_plug(current);
+
+	this_cpu_inc(q->poll_stat->polls);
+	start = ktime_to_ns(ktime_get());
+
+	while (!need_resched()) {
+		int ret;
+
+		preempt_disable();
+		__this_cpu_write(blk_poll_queue, q);
+		ret = q->poll_fn(q);
+		__this_cpu_write(blk_poll_queue, NULL);
+		preempt_enable();
+
+		if (ret > 0) {
+			this_cpu_inc(q->poll_stat->poll_hits);
+			set_current_state(TASK_RUNNING);
+			found = true;
+			break;
+		}
+
+		if (signal_pending_state(state, current))
+			set_current_state(TASK_RUNNING);
+		if (current->state == TASK_RUNNING) {
+			found = true;
+			break;
+		}
+		if (ret < 0)
+			break;
+		cpu_relax();
+	}
+
+	this_cpu_add(q->poll_stat->poll_time,
+		     ktime_to_ns(ktime_get()) - start);
+	return found;
+}
+EXPORT_SYMBOL_GPL(blk_poll);
+
+static void blk_lat_hist_add(struct request_queue *q, struct request *rq,
+			     u64 ns)
+{
+	unsigned int us, bucket, op;
+
+	if (rq->cmd_type != REQ_TYPE_FS || (rq->cmd_flags & REQ_FLUSH))
+		return;
+
+	if (rq->cmd_flags & REQ_DISCARD)
+		op = BLK_LAT_DISCARD;
+	else if (!rq_data_dir(rq))
+		op = BLK_LAT_READ;
+	else if (rq->cmd_flags & REQ_SYNC)
+		op = BLK_LAT_SYNC;
+	else
+		op = BLK_LAT_WRITE;
+
+	if (ns >= (u64)NSEC_PER_USEC << (BLK_LAT_BUCKETS - 1)) {
+		bucket = BLK_LAT_BUCKETS - 1;
+	} else {
+		us = (u32)ns / NSEC_PER_USEC;
+		bucket = fls(us);
+	}
+
+	this_cpu_inc(q->lat_hist->nr[op][rq->issue_size][bucket]);
+}
+
+/*
+ * Called on completion of a request that was timestamped by
+ * blk_account_io_issue().  May run in interrupt context.
+ */
+void __blk_account_io_latency(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	u64 now = ktime_to_ns(ktime_get());
+	u64 ns = now > rq->issue_time ? now - rq->issue_time : 0;
+
+	if (q->lat_hist)
+		blk_lat_hist_add(q, rq, ns);
+
+	if (q->poll_stat) {
+		int polled = !in_irq() && __this_cpu_read(blk_poll_queue) == q;
+
+		this_cpu_inc(q->poll_stat->nr[polled]);
+		this_cpu_add(q->poll_stat->time[polled], ns);
+	}
+
+	rq->issue_time = 0;
+}
+
 void blk_put_queue(struct request_queue *q)
 {
 	kobject_put(&q->kobj);
@@ -517,6 +640,12 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	if (!q)
 		return NULL;
 
+	q->lat_hist = alloc_percpu(struct blk_lat_hist);
+	if (!q->lat_hist) {
+		kmem_cache_free(blk_requestq_cachep, q);
+		return NULL;
+	}
+
 	q->backing_dev_info.unplug_io_fn = blk_backing_dev_unplug;
 	q->backing_dev_info.unplug_io_data = q;
 	q->backing_dev_info.ra_pages =
@@ -526,15 +655,11 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	q->backing_dev_info.name = "block";
 
 	err = bdi_init(&q->backing_dev_info);
-	if (err) {
-		kmem_cache_free(blk_requestq_cachep, q);
-		return NULL;
-	}
+	if (err)
+		goto out_free_hist;
 
-	if (blk_throtl_init(q)) {
-		kmem_cache_free(blk_requestq_cachep, q);
-		return NULL;
-	}
+	if (blk_throtl_init(q))
+		goto out_free_hist;
 
 	setup_timer(&q->backing_dev_info.laptop_mode_wb_timer,
 		    laptop_mode_timer_fn, (unsigned long) q);
@@ -550,6 +675,11 @@ struct request_queue *blk_alloc_queue_node(gfp_t gfp_mask, int node_id)
 	spin_lock_init(&q->__queue_lock);
 
 	return q;
+
+out_free_hist:
+	free_percpu(q->lat_hist);
+	kmem_cache_free(blk_requestq_cachep, q);
+	return NULL;
 }
 EXPORT_SYMBOL(blk_alloc_queue_node);
 
@@ -916,6 +1046,9 @@ struct request *blk_get_request(struct request_queue *q, int rw, gfp_t gfp_mask)
 
 	BUG_ON(rw != READ && rw != WRITE);
 
+	if (q->mq_ops)
+		return blk_mq_alloc_request(q, rw, gfp_mask);
+
 	spin_lock_irq(q->queue_lock);
 	if (gfp_mask & __GFP_WAIT) {
 		rq = get_request_wait(q, rw, NULL);
@@ -1109,6 +1242,11 @@ void __blk_put_request(struct request_queue *q, struct request *req)
 	if (unlikely(--req->ref_count))
 		return;
 
+	if (q->mq_ops) {
+		blk_mq_free_request(req);
+		return;
+	}
+
 	elv_completed_request(q, req);
 
 	/* this is a bio leak */
@@ -1136,6 +1274,11 @@ void blk_put_request(struct request *req)
 	unsigned long flags;
 	struct request_queue *q = req->q;
 
+	if (q->mq_ops) {
+		__blk_put_request(q, req);
+		return;
+	}
+
 	spin_lock_irqsave(q->queue_lock, flags);
 	__blk_put_request(q, req);
 	spin_unlock_irqrestore(q->queue_lock, flags);
@@ -1198,15 +1341,122 @@ static inline bool queue_should_plug(struct request_queue *q)
 	return !(blk_queue_nonrot(q) && blk_queue_tagged(q));
 }
 
+static bool bio_attempt_back_merge(struct request_queue *q,
+				   struct request *req, struct bio *bio)
+{
+	const int ff = bio->bi_rw & REQ_FAILFAST_MASK;
+
+	if (!ll_back_merge_fn(q, req, bio))
+		return false;
+
+	trace_block_bio_backmerge(q, bio);
+
+	if ((req->cmd_flags & REQ_FAILFAST_MASK) != ff)
+		blk_rq_set_mixed_merge(req);
+
+	req->biotail->bi_next = bio;
+	req->biotail = bio;
+	req->__data_len += bio->bi_size;
+	req->ioprio = ioprio_best(req->ioprio, bio_prio(bio));
+	if (!blk_rq_cpu_valid(req))
+		req->cpu = bio->bi_comp_cpu;
+	drive_stat_acct(req, 0);
+	return true;
+}
+
+static bool bio_attempt_front_merge(struct request_queue *q,
+				    struct request *req, struct bio *bio)
+{
+	const int ff = bio->bi_rw & REQ_FAILFAST_MASK;
+
+	if (!ll_front_merge_fn(q, req, bio))
+		return false;
+
+	trace_block_bio_frontmerge(q, bio);
+
+	if ((req->cmd_flags & REQ_FAILFAST_MASK) != ff) {
+		blk_rq_set_mixed_merge(req);
+		req->cmd_flags &= ~REQ_FAILFAST_MASK;
+		req->cmd_flags |= ff;
+	}
+
+	bio->bi_next = req->bio;
+	req->bio = bio;
+
+	/*
+	 * may not be valid. if the low level driver said
+	 * it didn't need a bounce buffer then it better
+	 * not touch req->buffer either...
+	 */
+	req->buffer = bio_data(bio);
+	req->__sector = bio->bi_sector;
+	req->__data_len += bio->bi_size;
+	req->ioprio = ioprio_best(req->ioprio, bio_prio(bio));
+	if (!blk_rq_cpu_valid(req))
+		req->cpu = bio->bi_comp_cpu;
+	drive_stat_acct(req, 0);
+	return true;
+}
+
+/*
+ * Attempts to merge with the plugged list in the current process.  The
+ * requests there are private to the task, no queue lock is needed.
+ * Returns true if the bio was merged.
+ */
+bool blk_attempt_plug_merge(struct task_struct *tsk, struct request_queue *q,
+			    struct bio *bio)
+{
+	struct blk_plug *plug = tsk->plug;
+	struct request *rq;
+
+	if (!plug)
+		return false;
+
+	list_for_each_entry_reverse(rq, &plug->list, queuelist) {
+		int el_ret;
+
+		if (rq->q != q)
+			continue;
+
+		el_ret = elv_try_merge(rq, bio);
+		if (el_ret == ELEVATOR_BACK_MERGE) {
+			if (bio_attempt_back_merge(q, rq, bio))
+				return true;
+		} else if (el_ret == ELEVATOR_FRONT_MERGE) {
+			if (bio_attempt_front_merge(q, rq, bio))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Queue a request on the plug of the current task.  It is accounted and
+ * inserted into its queue when the plug is flushed.
+ */
+void blk_add_plug_request(struct blk_plug *plug, struct request *req)
+{
+	if (!plug->should_sort && !list_empty(&plug->list)) {
+		struct request *__rq;
+
+		__rq = list_entry_rq(plug->list.prev);
+		if (__rq->q != req->q)
+			plug->should_sort = 1;
+	}
+	if (plug->count >= BLK_MAX_REQUEST_COUNT)
+		blk_flush_plug_list(plug, false);
+	list_add_tail(&req->queuelist, &plug->list);
+	plug->count++;
+}
+
 static int __make_request(struct request_queue *q, struct bio *bio)
 {
 	struct request *req;
+	struct blk_plug *plug;
 	int el_ret;
-	unsigned int bytes = bio->bi_size;
-	const unsigned short prio = bio_prio(bio);
 	const bool sync = !!(bio->bi_rw & REQ_SYNC);
 	const bool unplug = !!(bio->bi_rw & REQ_UNPLUG);
-	const unsigned long ff = bio->bi_rw & REQ_FAILFAST_MASK;
 	int where = ELEVATOR_INSERT_SORT;
 	int rw_flags;
 
@@ -1217,13 +1467,21 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	 */
 	blk_queue_bounce(q, &bio);
 
-	spin_lock_irq(q->queue_lock);
-
 	if (bio->bi_rw & (REQ_FLUSH | REQ_FUA)) {
+		spin_lock_irq(q->queue_lock);
 		where = ELEVATOR_INSERT_FRONT;
 		goto get_rq;
 	}
 
+	/*
+	 * Check if we can merge with the plugged list before grabbing
+	 * any locks.
+	 */
+	if (blk_attempt_plug_merge(current, q, bio))
+		return 0;
+
+	spin_lock_irq(q->queue_lock);
+
 	if (elv_queue_empty(q))
 		goto get_rq;
 
@@ -1232,21 +1490,9 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	case ELEVATOR_BACK_MERGE:
 		BUG_ON(!rq_mergeable(req));
 
-		if (!ll_back_merge_fn(q, req, bio))
+		if (!bio_attempt_back_merge(q, req, bio))
 			break;
 
-		trace_block_bio_backmerge(q, bio);
-
-		if ((req->cmd_flags & REQ_FAILFAST_MASK) != ff)
-			blk_rq_set_mixed_merge(req);
-
-		req->biotail->bi_next = bio;
-		req->biotail = bio;
-		req->__data_len += bytes;
-		req->ioprio = ioprio_best(req->ioprio, prio);
-		if (!blk_rq_cpu_valid(req))
-			req->cpu = bio->bi_comp_cpu;
-		drive_stat_acct(req, 0);
 		elv_bio_merged(q, req, bio);
 		if (!attempt_back_merge(q, req))
 			elv_merged_request(q, req, el_ret);
@@ -1255,32 +1501,9 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	case ELEVATOR_FRONT_MERGE:
 		BUG_ON(!rq_mergeable(req));
 
-		if (!ll_front_merge_fn(q, req, bio))
+		if (!bio_attempt_front_merge(q, req, bio))
 			break;
 
-		trace_block_bio_frontmerge(q, bio);
-
-		if ((req->cmd_flags & REQ_FAILFAST_MASK) != ff) {
-			blk_rq_set_mixed_merge(req);
-			req->cmd_flags &= ~REQ_FAILFAST_MASK;
-			req->cmd_flags |= ff;
-		}
-
-		bio->bi_next = req->bio;
-		req->bio = bio;
-
-		/*
-		 * may not be valid. if the low level driver said
-		 * it didn't need a bounce buffer then it better
-		 * not touch req->buffer either...
-		 */
-		req->buffer = bio_data(bio);
-		req->__sector = bio->bi_sector;
-		req->__data_len += bytes;
-		req->ioprio = ioprio_best(req->ioprio, prio);
-		if (!blk_rq_cpu_valid(req))
-			req->cpu = bio->bi_comp_cpu;
-		drive_stat_acct(req, 0);
 		elv_bio_merged(q, req, bio);
 		if (!attempt_front_merge(q, req))
 			elv_merged_request(q, req, el_ret);
@@ -1315,10 +1538,17 @@ get_rq:
 	 */
 	init_request_from_bio(req, bio);
 
-	spin_lock_irq(q->queue_lock);
 	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) ||
 	    bio_flagged(bio, BIO_CPU_AFFINE))
-		req->cpu = blk_cpu_to_group(smp_processor_id());
+		req->cpu = blk_cpu_to_group(raw_smp_processor_id());
+
+	plug = current->plug;
+	if (plug && where == ELEVATOR_INSERT_SORT) {
+		blk_add_plug_request(plug, req);
+		return 0;
+	}
+
+	spin_lock_irq(q->queue_lock);
 	if (queue_should_plug(q) && elv_queue_empty(q))
 		blk_plug_device(q);
 
@@ -1798,7 +2028,7 @@ static void blk_account_io_completion(struct request *req, unsigned int bytes)
 	}
 }
 
-static void blk_account_io_done(struct request *req)
+void blk_account_io_done(struct request *req)
 {
 	/*
 	 * Account IO completion.  flush_rq isn't accounted as a
@@ -1971,6 +2201,7 @@ void blk_start_request(struct request *req)
 		req->next_rq->resid_len = blk_rq_bytes(req->next_rq);
 
 	blk_add_timer(req);
+	blk_account_io_issue(req);
 }
 EXPORT_SYMBOL(blk_start_request);
 
@@ -2214,6 +2445,7 @@ static void blk_finish_request(struct request *req, int error)
 
 
 	blk_account_io_done(req);
+	blk_account_io_latency(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
@@ -2611,6 +2843,144 @@ int kblockd_schedule_work(struct request_queue *q, struct work_struct *work)
 }
 EXPORT_SYMBOL(kblockd_schedule_work);
 
+#define PLUG_MAGIC	0x91827364
+
+/**
+ * blk_start_plug - start batching the requests of the current task
+ * @plug:	The &struct blk_plug that needs to be initialized
+ *
+ * Description:
+ *   Requests the task submits from now on are collected on @plug instead
+ *   of being inserted into the elevator one by one, until @plug is passed
+ *   to blk_finish_plug().  If the task already has a plug, that outer plug
+ *   keeps collecting the requests.
+ */
+void blk_start_plug(struct blk_plug *plug)
+{
+	struct task_struct *tsk = current;
+
+	plug->magic = PLUG_MAGIC;
+	INIT_LIST_HEAD(&plug->list);
+	plug->count = 0;
+	plug->should_sort = 0;
+
+	/*
+	 * If this is a nested plug, don't actually assign it.  It will be
+	 * flushed on its own, but only the outermost plug is used for
+	 * collecting requests.
+	 */
+	if (!tsk->plug)
+		tsk->plug = plug;
+}
+EXPORT_SYMBOL(blk_start_plug);
+
+static int plug_rq_cmp(void *priv, struct list_head *a, struct list_head *b)
+{
+	struct request *rqa = container_of(a, struct request, queuelist);
+	struct request *rqb = container_of(b, struct request, queuelist);
+
+	return !(rqa->q <= rqb->q);
+}
+
+static void queue_unplugged(struct request_queue *q, bool from_schedule)
+{
+	trace_block_unplug_io(q);
+
+	/*
+	 * Don't run the request_fn from inside schedule(), the driver may
+	 * block or use a lot of stack.  Let kblockd run the queue instead.
+	 */
+	__blk_run_queue(q, from_schedule);
+}
+
+/**
+ * blk_flush_plug_list - hand the requests on a plug to their queues
+ * @plug:	The &struct blk_plug to flush
+ * @from_schedule: called from schedule(), the queues are run by kblockd
+ *
+ * Description:
+ *   The requests are sorted by queue, accounted and inserted into the
+ *   elevator of their queue with one queue lock round trip per queue,
+ *   then the queues are run.
+ */
+void blk_flush_plug_list(struct blk_plug *plug, bool from_schedule)
+{
+	struct request_queue *q;
+	unsigned long flags;
+	struct request *rq, *next;
+	LIST_HEAD(list);
+	LIST_HEAD(mq_list);
+
+	BUG_ON(plug->magic != PLUG_MAGIC);
+
+	if (list_empty(&plug->list))
+		return;
+
+	list_splice_init(&plug->list, &list);
+	plug->count = 0;
+
+	if (plug->should_sort) {
+		list_sort(NULL, &list, plug_rq_cmp);
+		plug->should_sort = 0;
+	}
+
+	/*
+	 * Requests of multiqueue devices bypass the queue lock and the
+	 * elevator altogether.
+	 */
+	list_for_each_entry_safe(rq, next, &list, queuelist) {
+		if (rq->q->mq_ops)
+			list_move_tail(&rq->queuelist, &mq_list);
+	}
+	if (!list_empty(&mq_list))
+		blk_mq_flush_plug_list(&mq_list, from_schedule);
+
+	q = NULL;
+
+	/*
+	 * Save and disable interrupts here, to avoid doing it for every
+	 * queue lock we have to take.
+	 */
+	local_irq_save(flags);
+	while (!list_empty(&list)) {
+		rq = list_entry_rq(list.next);
+		list_del_init(&rq->queuelist);
+		BUG_ON(!rq->q);
+		if (rq->q != q) {
+			if (q) {
+				queue_unplugged(q, from_schedule);
+				spin_unlock(q->queue_lock);
+			}
+			q = rq->q;
+			spin_lock(q->queue_lock);
+		}
+
+		drive_stat_acct(rq, 1);
+		__elv_add_request(q, rq, ELEVATOR_INSERT_SORT, 0);
+	}
+
+	if (q) {
+		queue_unplugged(q, from_schedule);
+		spin_unlock(q->queue_lock);
+	}
+
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(blk_flush_plug_list);
+
+/**
+ * blk_finish_plug - submit the requests batched since blk_start_plug()
+ * @plug:	The &struct blk_plug passed to blk_start_plug()
+ */
+void blk_finish_plug(struct blk_plug *plug)
+{
+	blk_flush_plug_list(plug, false);
+
+	if (plug == current->plug)
+		current->plug = NULL;
+}
+EXPORT_SYMBOL(blk_finish_plug);
+
 int __init blk_dev_init(void)
 {
 	BUILD_BUG_ON(__REQ_NR_BITS > 8 *
@@ -0,0 +1,116 @@
+/*
+ * Tag allocation for the hardware queues of multiqueue devices
+ *
+ * Each hardware queue has a bitmap with a bit per request it owns.
+ * Allocation starts looking where the submitting cpu last found a free
+ * tag, so that cpus sharing a hardware queue tend to work on different
+ * words of the bitmap instead of bouncing the first one around.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+#include <linux/blk-mq.h>
+
+#include "blk-mq.h"
+
+struct blk_mq_tags {
+	unsigned int		nr_tags;
+	unsigned long		*bitmap;
+	wait_queue_head_t	wait;
+};
+
+static unsigned int __blk_mq_get_tag(struct blk_mq_tags *tags,
+				     unsigned int *last_tag)
+{
+	unsigned int start = *last_tag;
+	unsigned int tag;
+
+	if (start >= tags->nr_tags)
+		start = 0;
+
+	for (;;) {
+		tag = find_next_zero_bit(tags->bitmap, tags->nr_tags, start);
+		if (tag >= tags->nr_tags) {
+			if (!start)
+				return BLK_MQ_TAG_FAIL;
+			start = 0;
+			continue;
+		}
+		if (!test_and_set_bit_lock(tag, tags->bitmap))
+			break;
+	}
+
+	*last_tag = tag + 1;
+	return tag;
+}
+
+/**
+ * blk_mq_get_tag - allocate a tag
+ * @tags:	tag map of the hardware queue
+ * @last_tag:	allocation hint of the software queue
+ * @gfp:	sleep until a tag is freed if this has __GFP_WAIT
+ *
+ * Returns the tag, or BLK_MQ_TAG_FAIL if none is free and @gfp does
+ * not allow waiting.
+ */
+unsigned int blk_mq_get_tag(struct blk_mq_tags *tags, unsigned int *last_tag,
+			    gfp_t gfp)
+{
+	DEFINE_WAIT(wait);
+	unsigned int tag;
+
+	tag = __blk_mq_get_tag(tags, last_tag);
+	if (tag != BLK_MQ_TAG_FAIL || !(gfp & __GFP_WAIT))
+		return tag;
+
+	for (;;) {
+		prepare_to_wait_exclusive(&tags->wait, &wait,
+					  TASK_UNINTERRUPTIBLE);
+		tag = __blk_mq_get_tag(tags, last_tag);
+		if (tag != BLK_MQ_TAG_FAIL)
+			break;
+		io_schedule();
+	}
+	finish_wait(&tags->wait, &wait);
+
+	return tag;
+}
+
+void blk_mq_put_tag(struct blk_mq_tags *tags, unsigned int tag)
+{
+	BUG_ON(tag >= tags->nr_tags);
+
+	clear_bit_unlock(tag, tags->bitmap);
+	smp_mb__after_clear_bit();
+	if (waitqueue_active(&tags->wait))
+		wake_up(&tags->wait);
+}
+
+struct blk_mq_tags *blk_mq_init_tags(unsigned int nr_tags, int node)
+{
+	struct blk_mq_tags *tags;
+
+	tags = kzalloc_node(sizeof(*tags), GFP_KERNEL, node);
+	if (!tags)
+		return NULL;
+
+	tags->bitmap = kzalloc_node(BITS_TO_LONGS(nr_tags) * sizeof(long),
+				    GFP_KERNEL, node);
+	if (!tags->bitmap) {
+		kfree(tags);
+		return NULL;
+	}
+
+	tags->nr_tags = nr_tags;
+	init_waitqueue_head(&tags->wait);
+	return tags;
+}
+
+void blk_mq_free_tags(struct blk_mq_tags *tags)
+{
+	kfree(tags->bitmap);
+	kfree(tags);
+}
@@ -0,0 +1,720 @@
+/*
+ * Block multiqueue core code
+ *
+ * Bios are turned into requests on per-cpu software queues, which are
+ * mapped onto the hardware dispatch queues the driver exposes.  Every
+ * hardware queue owns its requests and a tag map to allocate them
+ * from, so submission never takes a lock shared by all cpus.  There is
+ * no I/O scheduler; merging is only done on the per-task plug list.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/sched.h>
+#include <linux/smp.h>
+
+#include <trace/events/block.h>
+
+#include "blk.h"
+#include "blk-mq.h"
+
+static struct blk_mq_ctx *__blk_mq_get_ctx(struct request_queue *q,
+					   unsigned int cpu)
+{
+	return per_cpu_ptr(q->queue_ctx, cpu);
+}
+
+/**
+ * blk_mq_map_queue - hardware queue serving a cpu
+ * @q:		multiqueue device
+ * @cpu:	cpu submitting the I/O
+ */
+struct blk_mq_hw_ctx *blk_mq_map_queue(struct request_queue *q,
+				       unsigned int cpu)
+{
+	return q->queue_hw_ctx[q->mq_map[cpu]];
+}
+EXPORT_SYMBOL(blk_mq_map_queue);
+
+static bool blk_mq_hctx_has_pending(struct blk_mq_hw_ctx *hctx)
+{
+	return !list_empty_careful(&hctx->dispatch) ||
+		!bitmap_empty(hctx->ctx_map, hctx->nr_ctx);
+}
+
+static struct request *__blk_mq_alloc_request(struct request_queue *q,
+					      struct blk_mq_ctx *ctx,
+					      int rw, gfp_t gfp)
+{
+	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(q, ctx->cpu);
+	struct request *rq;
+	unsigned int tag;
+
+	tag = blk_mq_get_tag(hctx->tags, &ctx->last_tag, gfp);
+	if (tag == BLK_MQ_TAG_FAIL)
+		return NULL;
+
+	rq = hctx->rqs[tag];
+	blk_rq_init(q, rq);
+	rq->tag = tag;
+	rq->mq_ctx = ctx;
+	rq->cmd_flags = rw;
+	return rq;
+}
+
+/**
+ * blk_mq_alloc_request - allocate a request on a multiqueue device
+ * @q:		multiqueue device
+ * @rw:		READ or WRITE, with any additional REQ_* flags
+ * @gfp:	wait for a free tag if this has __GFP_WAIT
+ *
+ * The request comes from the hardware queue of the current cpu and
+ * must be released with blk_mq_free_request() or blk_put_request().
+ */
+struct request *blk_mq_alloc_request(struct request_queue *q, int rw,
+				     gfp_t gfp)
+{
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+
+	ctx = __blk_mq_get_ctx(q, get_cpu());
+	rq = __blk_mq_alloc_request(q, ctx, rw, gfp & ~__GFP_WAIT);
+	put_cpu();
+
+	/*
+	 * Waiting for a tag may move us to another cpu, that is fine:
+	 * the request only has to be queued on a software queue that
+	 * belongs to the hardware queue the tag came from.
+	 */
+	if (!rq && (gfp & __GFP_WAIT)) {
+		ctx = __blk_mq_get_ctx(q, raw_smp_processor_id());
+		rq = __blk_mq_alloc_request(q, ctx, rw, gfp);
+	}
+
+	return rq;
+}
+EXPORT_SYMBOL(blk_mq_alloc_request);
+
+/**
+ * blk_mq_free_request - release a request and its tag
+ * @rq:		request allocated with blk_mq_alloc_request()
+ */
+void blk_mq_free_request(struct request *rq)
+{
+	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(rq->q, rq->mq_ctx->cpu);
+
+	/* this is a bio leak */
+	WARN_ON(rq->bio != NULL);
+
+	rq->cmd_flags = 0;
+	blk_mq_put_tag(hctx->tags, rq->tag);
+}
+EXPORT_SYMBOL(blk_mq_free_request);
+
+/**
+ * blk_mq_end_io - complete a request
+ * @rq:		request handed to ->queue_rq()
+ * @error:	0 for success, < 0 for error
+ *
+ * Completes all of @rq and releases it, unless it was issued with an
+ * end_io callback.  May be called from interrupt context.
+ */
+void blk_mq_end_io(struct request *rq, int error)
+{
+	if (blk_update_request(rq, error, blk_rq_bytes(rq)))
+		BUG();
+
+	blk_account_io_done(rq);
+	blk_account_io_latency(rq);
+
+	if (rq->end_io)
+		rq->end_io(rq, error);
+	else
+		__blk_put_request(rq->q, rq);
+}
+EXPORT_SYMBOL(blk_mq_end_io);
+
+static void __blk_mq_insert_request(struct blk_mq_hw_ctx *hctx,
+				    struct request *rq, bool at_head)
+{
+	struct blk_mq_ctx *ctx = rq->mq_ctx;
+
+	trace_block_rq_insert(hctx->queue, rq);
+
+	spin_lock(&ctx->lock);
+	if (at_head)
+		list_add(&rq->queuelist, &ctx->rq_list);
+	else
+		list_add_tail(&rq->queuelist, &ctx->rq_list);
+	spin_unlock(&ctx->lock);
+
+	if (!test_bit(ctx->index_hw, hctx->ctx_map))
+		set_bit(ctx->index_hw, hctx->ctx_map);
+}
+
+/**
+ * blk_mq_insert_request - queue a request on its software queue
+ * @rq:		request to insert
+ * @at_head:	insert at the head of the software queue
+ * @run_queue:	run the hardware queue afterwards
+ * @async:	run the hardware queue from kblockd
+ */
+void blk_mq_insert_request(struct request *rq, bool at_head, bool run_queue,
+			   bool async)
+{
+	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(rq->q, rq->mq_ctx->cpu);
+
+	__blk_mq_insert_request(hctx, rq, at_head);
+
+	if (run_queue)
+		blk_mq_run_hw_queue(hctx, async);
+}
+
+/*
+ * Insert the requests of a flushed plug and run each hardware queue
+ * once.  The list holds requests of multiqueue devices only.
+ */
+void blk_mq_flush_plug_list(struct list_head *list, bool from_schedule)
+{
+	struct blk_mq_hw_ctx *hctx, *last = NULL;
+	struct request *rq;
+
+	while (!list_empty(list)) {
+		rq = list_entry_rq(list->next);
+		list_del_init(&rq->queuelist);
+
+		hctx = blk_mq_map_queue(rq->q, rq->mq_ctx->cpu);
+		drive_stat_acct(rq, 1);
+		__blk_mq_insert_request(hctx, rq, false);
+
+		if (hctx != last) {
+			if (last)
+				blk_mq_run_hw_queue(last, from_schedule);
+			last = hctx;
+		}
+	}
+
+	if (last)
+		blk_mq_run_hw_queue(last, from_schedule);
+}
+
+static void blk_mq_start_request(struct blk_mq_hw_ctx *hctx,
+				 struct request *rq)
+{
+	trace_block_rq_issue(hctx->queue, rq);
+	rq->cmd_flags |= REQ_STARTED;
+	blk_account_io_issue(rq);
+}
+
+static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	struct request_queue *q = hctx->queue;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+	LIST_HEAD(rq_list);
+	int bit;
+
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	hctx->run++;
+
+	/*
+	 * Touch any software queue that has pending entries.
+	 */
+	for_each_set_bit(bit, hctx->ctx_map, hctx->nr_ctx) {
+		clear_bit(bit, hctx->ctx_map);
+		ctx = hctx->ctxs[bit];
+
+		spin_lock(&ctx->lock);
+		list_splice_tail_init(&ctx->rq_list, &rq_list);
+		spin_unlock(&ctx->lock);
+	}
+
+	/*
+	 * Requests the driver bounced earlier go first.
+	 */
+	if (!list_empty_careful(&hctx->dispatch)) {
+		spin_lock(&hctx->lock);
+		list_splice_init(&hctx->dispatch, &rq_list);
+		spin_unlock(&hctx->lock);
+	}
+
+	while (!list_empty(&rq_list)) {
+		int ret;
+
+		rq = list_entry_rq(rq_list.next);
+		list_del_init(&rq->queuelist);
+
+		blk_mq_start_request(hctx, rq);
+
+		ret = q->mq_ops->queue_rq(hctx, rq, list_empty(&rq_list));
+		if (ret == BLK_MQ_RQ_QUEUE_OK)
+			continue;
+		if (ret == BLK_MQ_RQ_QUEUE_BUSY) {
+			rq->cmd_flags &= ~REQ_STARTED;
+			list_add(&rq->queuelist, &rq_list);
+			break;
+		}
+
+		WARN_ON_ONCE(ret != BLK_MQ_RQ_QUEUE_ERROR);
+		blk_mq_end_io(rq, -EIO);
+	}
+
+	if (list_empty(&rq_list))
+		return;
+
+	spin_lock(&hctx->lock);
+	list_splice(&rq_list, &hctx->dispatch);
+	spin_unlock(&hctx->lock);
+
+	/*
+	 * A driver returning BLK_MQ_RQ_QUEUE_BUSY stops the queue and
+	 * starts it again once it has room.  If that already happened,
+	 * the run it triggered may have missed the requests just put
+	 * back, so run the queue once more.
+	 */
+	if (!test_bit(BLK_MQ_S_STOPPED, &hctx->state))
+		blk_mq_run_hw_queue(hctx, true);
+}
+
+/**
+ * blk_mq_run_hw_queue - dispatch the pending requests of a hardware queue
+ * @hctx:	hardware queue to run
+ * @async:	let kblockd do it rather than the caller
+ */
+void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx, bool async)
+{
+	if (unlikely(test_bit(BLK_MQ_S_STOPPED, &hctx->state)))
+		return;
+
+	if (!async)
+		__blk_mq_run_hw_queue(hctx);
+	else
+		kblockd_schedule_work(hctx->queue, &hctx->run_work);
+}
+EXPORT_SYMBOL(blk_mq_run_hw_queue);
+
+/**
+ * blk_mq_run_queues - run all hardware queues with pending requests
+ * @q:		multiqueue device
+ * @async:	let kblockd do it rather than the caller
+ */
+void blk_mq_run_queues(struct request_queue *q, bool async)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (blk_mq_hctx_has_pending(hctx))
+			blk_mq_run_hw_queue(hctx, async);
+	}
+}
+EXPORT_SYMBOL(blk_mq_run_queues);
+
+/**
+ * blk_mq_stop_hw_queue - stop dispatching to a hardware queue
+ * @hctx:	hardware queue to stop
+ *
+ * Typically called by a driver from ->queue_rq() when the device is
+ * full, before returning BLK_MQ_RQ_QUEUE_BUSY.
+ */
+void blk_mq_stop_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	set_bit(BLK_MQ_S_STOPPED, &hctx->state);
+}
+EXPORT_SYMBOL(blk_mq_stop_hw_queue);
+
+/**
+ * blk_mq_start_stopped_hw_queues - restart the stopped hardware queues
+ * @q:		multiqueue device
+ *
+ * The queues are run from kblockd, this may be called from interrupt
+ * context.
+ */
+void blk_mq_start_stopped_hw_queues(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (!test_and_clear_bit(BLK_MQ_S_STOPPED, &hctx->state))
+			continue;
+		blk_mq_run_hw_queue(hctx, true);
+	}
+}
+EXPORT_SYMBOL(blk_mq_start_stopped_hw_queues);
+
+static void blk_mq_work_fn(struct work_struct *work)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	hctx = container_of(work, struct blk_mq_hw_ctx, run_work);
+	__blk_mq_run_hw_queue(hctx);
+}
+
+static void blk_mq_unplug(struct request_queue *q)
+{
+	blk_mq_run_queues(q, false);
+}
+
+static int blk_mq_poll(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx = blk_mq_map_queue(q, smp_processor_id());
+
+	return q->mq_ops->poll(hctx);
+}
+
+static void blk_mq_flush_end_io(struct request *rq, int error)
+{
+	struct completion *waiting = rq->end_io_data;
+
+	rq->errors = error;
+	complete(waiting);
+}
+
+static int blk_mq_issue_flush(struct request_queue *q, struct gendisk *disk)
+{
+	DECLARE_COMPLETION_ONSTACK(wait);
+	struct request *rq;
+	int err;
+
+	rq = blk_mq_alloc_request(q, WRITE_FLUSH, GFP_NOIO);
+	rq->cmd_type = REQ_TYPE_FS;
+	rq->end_io_data = &wait;
+	blk_execute_rq_nowait(q, disk, rq, 0, blk_mq_flush_end_io);
+	wait_for_completion(&wait);
+
+	err = rq->errors;
+	blk_mq_free_request(rq);
+	return err;
+}
+
+struct blk_mq_fua_wait {
+	struct completion	done;
+	int			error;
+};
+
+static void blk_mq_fua_end_io(struct bio *bio, int error)
+{
+	struct blk_mq_fua_wait *w = bio->bi_private;
+
+	w->error = error;
+	complete(&w->done);
+}
+
+static void __blk_mq_make_request(struct request_queue *q, struct bio *bio);
+
+/*
+ * There is no flush state machine for multiqueue devices: a bio with
+ * REQ_FLUSH or REQ_FUA is sequenced in the context of its submitter.
+ * The cache is flushed first, then the data is written, and if the
+ * device cannot do FUA the data is waited for and the cache flushed
+ * once more before the bio is completed.
+ */
+static void blk_mq_flush_bio(struct request_queue *q, struct bio *bio)
+{
+	unsigned int fflags = q->flush_flags;
+	struct gendisk *disk = bio->bi_bdev->bd_disk;
+	struct blk_mq_fua_wait w;
+	bio_end_io_t *end_io;
+	void *private;
+	int err = 0;
+
+	if ((bio->bi_rw & REQ_FLUSH) && (fflags & REQ_FLUSH))
+		err = blk_mq_issue_flush(q, disk);
+	if (err || !bio->bi_size) {
+		bio_endio(bio, err);
+		return;
+	}
+
+	bio->bi_rw &= ~REQ_FLUSH;
+	if (!(bio->bi_rw & REQ_FUA) || (fflags & REQ_FUA)) {
+		__blk_mq_make_request(q, bio);
+		return;
+	}
+
+	bio->bi_rw &= ~REQ_FUA;
+	end_io = bio->bi_end_io;
+	private = bio->bi_private;
+
+	init_completion(&w.done);
+	bio->bi_end_io = blk_mq_fua_end_io;
+	bio->bi_private = &w;
+	__blk_mq_make_request(q, bio);
+	wait_for_completion(&w.done);
+
+	err = w.error;
+	if (!err && (fflags & REQ_FLUSH))
+		err = blk_mq_issue_flush(q, disk);
+
+	bio->bi_end_io = end_io;
+	bio->bi_private = private;
+	bio_endio(bio, err);
+}
+
+static void __blk_mq_make_request(struct request_queue *q, struct bio *bio)
+{
+	const bool sync = !!(bio->bi_rw & REQ_SYNC);
+	struct blk_plug *plug;
+	struct request *rq;
+	int rw_flags;
+
+	if (blk_attempt_plug_merge(current, q, bio))
+		return;
+
+	rw_flags = bio_data_dir(bio);
+	if (sync)
+		rw_flags |= REQ_SYNC;
+
+	rq = blk_mq_alloc_request(q, rw_flags, GFP_NOIO);
+	trace_block_getrq(q, bio, bio_data_dir(bio));
+
+	if (blk_queue_io_stat(q))
+		rq->cmd_flags |= REQ_IO_STAT;
+	init_request_from_bio(rq, bio);
+
+	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags) ||
+	    bio_flagged(bio, BIO_CPU_AFFINE))
+		rq->cpu = blk_cpu_to_group(raw_smp_processor_id());
+
+	plug = current->plug;
+	if (plug) {
+		blk_add_plug_request(plug, rq);
+		return;
+	}
+
+	drive_stat_acct(rq, 1);
+	blk_mq_insert_request(rq, false, true, !sync);
+}
+
+static int blk_mq_make_request(struct request_queue *q, struct bio *bio)
+{
+	blk_queue_bounce(q, &bio);
+
+	if (bio->bi_rw & (REQ_FLUSH | REQ_FUA))
+		blk_mq_flush_bio(q, bio);
+	else
+		__blk_mq_make_request(q, bio);
+
+	return 0;
+}
+
+/*
+ * Spread the possible cpus evenly over the hardware queues, giving
+ * each queue a range of neighbouring cpus.
+ */
+static void blk_mq_map_swqueues(struct request_queue *q)
+{
+	unsigned int nr_cpus = num_possible_cpus();
+	unsigned int i, nr = 0;
+
+	for_each_possible_cpu(i) {
+		struct blk_mq_ctx *ctx = __blk_mq_get_ctx(q, i);
+		struct blk_mq_hw_ctx *hctx;
+
+		q->mq_map[i] = nr++ * q->nr_hw_queues / nr_cpus;
+		hctx = blk_mq_map_queue(q, i);
+
+		spin_lock_init(&ctx->lock);
+		INIT_LIST_HEAD(&ctx->rq_list);
+		ctx->cpu = i;
+		ctx->queue = q;
+		ctx->index_hw = hctx->nr_ctx;
+		hctx->ctxs[hctx->nr_ctx++] = ctx;
+	}
+}
+
+static void blk_mq_free_rqs(struct blk_mq_hw_ctx *hctx, unsigned int depth)
+{
+	unsigned int i;
+
+	if (!hctx->rqs)
+		return;
+
+	for (i = 0; i < depth; i++)
+		kfree(hctx->rqs[i]);
+	kfree(hctx->rqs);
+}
+
+static int blk_mq_init_hw_queue(struct request_queue *q,
+				struct blk_mq_hw_ctx *hctx,
+				struct blk_mq_reg *reg, unsigned int i)
+{
+	size_t rq_size = sizeof(struct request) + reg->cmd_size;
+	int node = reg->numa_node;
+	unsigned int j;
+
+	spin_lock_init(&hctx->lock);
+	INIT_LIST_HEAD(&hctx->dispatch);
+	INIT_WORK(&hctx->run_work, blk_mq_work_fn);
+	hctx->queue = q;
+	hctx->queue_num = i;
+	hctx->numa_node = node;
+
+	hctx->ctxs = kzalloc_node(nr_cpu_ids * sizeof(void *), GFP_KERNEL,
+				  node);
+	hctx->ctx_map = kzalloc_node(BITS_TO_LONGS(nr_cpu_ids) *
+				     sizeof(long), GFP_KERNEL, node);
+	hctx->tags = blk_mq_init_tags(reg->queue_depth, node);
+	hctx->rqs = kzalloc_node(reg->queue_depth * sizeof(void *),
+				 GFP_KERNEL, node);
+	if (!hctx->ctxs || !hctx->ctx_map || !hctx->tags || !hctx->rqs)
+		return -ENOMEM;
+
+	/*
+	 * The driver data lives behind each request and may be handed to
+	 * the device, so the requests are allocated one by one instead
+	 * of as one large virtually contiguous array.
+	 */
+	for (j = 0; j < reg->queue_depth; j++) {
+		hctx->rqs[j] = kzalloc_node(rq_size, GFP_KERNEL, node);
+		if (!hctx->rqs[j])
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void blk_mq_free_hw_queues(struct request_queue *q,
+				  unsigned int depth)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned int i;
+
+	for (i = 0; q->queue_hw_ctx && i < q->nr_hw_queues; i++) {
+		hctx = q->queue_hw_ctx[i];
+		if (!hctx)
+			continue;
+
+		blk_mq_free_rqs(hctx, depth);
+		if (hctx->tags)
+			blk_mq_free_tags(hctx->tags);
+		kfree(hctx->ctx_map);
+		kfree(hctx->ctxs);
+		kfree(hctx);
+	}
+
+	kfree(q->queue_hw_ctx);
+	free_percpu(q->queue_ctx);
+	kfree(q->mq_map);
+}
+
+/**
+ * blk_mq_init_queue - set up a multiqueue device
+ * @reg:	queue count, depth and driver operations
+ * @driver_data: stored in the queue's ->queuedata
+ *
+ * Description:
+ *    Returns a request queue whose bios are turned into requests on
+ *    per-cpu software queues and dispatched through @reg->nr_hw_queues
+ *    hardware queues of @reg->queue_depth requests each.  Like any
+ *    other queue it is released with blk_cleanup_queue().
+ *
+ *    Returns %NULL on failure.
+ */
+struct request_queue *blk_mq_init_queue(struct blk_mq_reg *reg,
+					void *driver_data)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct request_queue *q;
+	int i;
+
+	if (!reg->nr_hw_queues || !reg->ops->queue_rq ||
+	    !reg->queue_depth || reg->queue_depth > BLK_MQ_MAX_DEPTH)
+		return NULL;
+
+	q = blk_alloc_queue_node(GFP_KERNEL, reg->numa_node);
+	if (!q)
+		return NULL;
+
+	q->nr_hw_queues = reg->nr_hw_queues;
+	q->queue_ctx = alloc_percpu(struct blk_mq_ctx);
+	q->queue_hw_ctx = kzalloc_node(reg->nr_hw_queues * sizeof(void *),
+				       GFP_KERNEL, reg->numa_node);
+	q->mq_map = kzalloc_node(nr_cpu_ids * sizeof(unsigned int),
+				 GFP_KERNEL, reg->numa_node);
+	if (!q->queue_ctx || !q->queue_hw_ctx || !q->mq_map)
+		goto err_hw;
+
+	for (i = 0; i < reg->nr_hw_queues; i++) {
+		hctx = kzalloc_node(sizeof(*hctx), GFP_KERNEL, reg->numa_node);
+		if (!hctx)
+			goto err_hw;
+		q->queue_hw_ctx[i] = hctx;
+
+		if (blk_mq_init_hw_queue(q, hctx, reg, i))
+			goto err_hw;
+	}
+
+	blk_mq_map_swqueues(q);
+
+	q->queuedata = driver_data;
+	q->node = reg->numa_node;
+	q->queue_flags = QUEUE_FLAG_DEFAULT;
+	q->queue_depth = reg->queue_depth;
+
+	blk_queue_make_request(q, blk_mq_make_request);
+	q->unplug_fn = blk_mq_unplug;
+	q->nr_requests = reg->queue_depth * reg->nr_hw_queues;
+	q->sg_reserved_size = INT_MAX;
+
+	if (reg->ops->poll && blk_queue_poll_fn(q, blk_mq_poll))
+		goto err_hw;
+
+	if (reg->ops->init_hctx) {
+		queue_for_each_hw_ctx(q, hctx, i) {
+			if (reg->ops->init_hctx(hctx, driver_data, i))
+				goto err_init;
+		}
+	}
+
+	/* Set last, blk_release_queue() takes it to mean "fully set up" */
+	q->mq_ops = reg->ops;
+	return q;
+
+err_init:
+	while (--i >= 0) {
+		if (reg->ops->exit_hctx)
+			reg->ops->exit_hctx(q->queue_hw_ctx[i], i);
+	}
+err_hw:
+	blk_mq_free_hw_queues(q, reg->queue_depth);
+	q->queue_hw_ctx = NULL;
+	q->queue_ctx = NULL;
+	q->mq_map = NULL;
+	blk_cleanup_queue(q);
+	return NULL;
+}
+EXPORT_SYMBOL(blk_mq_init_queue);
+
+/* Called from blk_sync_queue() */
+void blk_mq_sync_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		cancel_work_sync(&hctx->run_work);
+}
+
+/* Called from blk_release_queue() when the last reference is gone */
+void blk_mq_free_queue(struct request_queue *q)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		cancel_work_sync(&hctx->run_work);
+		if (q->mq_ops->exit_hctx)
+			q->mq_ops->exit_hctx(hctx, i);
+	}
+
+	blk_mq_free_hw_queues(q, q->queue_depth);
+}
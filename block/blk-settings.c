@@ -11,6 +11,7 @@
 #include <linux/lcm.h>
 #include <linux/jiffies.h>
 #include <linux/gfp.h>
+#include <linux/percpu.h>
 
 #include "blk.h"
 
@@ -805,6 +806,31 @@ void blk_queue_flush(struct request_queue *q, unsigned int flush)
 }
 EXPORT_SYMBOL_GPL(blk_queue_flush);
 
+/**
+ * blk_queue_poll_fn - set the completion polling function of a queue
+ * @q:		the request queue for the device
+ * @fn:		reaps completed requests, returns how many it found
+ *
+ * Description:
+ *    @fn lets tasks that wait for synchronous I/O spin on the device's
+ *    completion queue instead of sleeping until the interrupt, see
+ *    blk_poll().  It is called with preemption disabled, concurrently
+ *    with the interrupt handler.  Polling still has to be enabled
+ *    through the io_poll queue attribute.
+ */
+int blk_queue_poll_fn(struct request_queue *q, poll_queue_fn *fn)
+{
+	if (!q->poll_stat) {
+		q->poll_stat = alloc_percpu(struct blk_poll_stat);
+		if (!q->poll_stat)
+			return -ENOMEM;
+	}
+
+	q->poll_fn = fn;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(blk_queue_poll_fn);
+
 static int __init blk_settings_init(void)
 {
 	blk_max_low_pfn = max_low_pfn - 1;
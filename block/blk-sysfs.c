@@ -7,8 +7,10 @@
 #include <linux/bio.h>
 #include <linux/blkdev.h>
 #include <linux/blktrace_api.h>
+#include <linux/math64.h>
 
 #include "blk.h"
+#include "blk-mq.h"
 
 struct queue_sysfs_entry {
 	struct attribute attr;
@@ -216,6 +218,113 @@ QUEUE_SYSFS_BIT_FNS(random, ADD_RANDOM, 0);
 QUEUE_SYSFS_BIT_FNS(iostats, IO_STAT, 0);
 #undef QUEUE_SYSFS_BIT_FNS
 
+static ssize_t queue_poll_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(blk_queue_poll(q), page);
+}
+
+static ssize_t queue_poll_store(struct request_queue *q, const char *page,
+				size_t count)
+{
+	unsigned long poll;
+	ssize_t ret;
+
+	if (!q->poll_fn)
+		return -EINVAL;
+
+	ret = queue_var_store(&poll, page, count);
+	spin_lock_irq(q->queue_lock);
+	if (poll)
+		queue_flag_set(QUEUE_FLAG_POLL, q);
+	else
+		queue_flag_clear(QUEUE_FLAG_POLL, q);
+	spin_unlock_irq(q->queue_lock);
+
+	return ret;
+}
+
+static ssize_t queue_poll_stats_show(struct request_queue *q, char *page)
+{
+	struct blk_poll_stat sum;
+	int cpu, i;
+
+	if (!q->poll_stat)
+		return -EINVAL;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		struct blk_poll_stat *ps = per_cpu_ptr(q->poll_stat, cpu);
+
+		sum.polls += ps->polls;
+		sum.poll_hits += ps->poll_hits;
+		sum.poll_time += ps->poll_time;
+		for (i = 0; i < 2; i++) {
+			sum.nr[i] += ps->nr[i];
+			sum.time[i] += ps->time[i];
+		}
+	}
+
+	return sprintf(page,
+		       "polls %lu\n"
+		       "poll_hits %lu\n"
+		       "poll_time_ns %llu\n"
+		       "irq_completed %lu\n"
+		       "irq_latency_ns %llu\n"
+		       "poll_completed %lu\n"
+		       "poll_latency_ns %llu\n",
+		       sum.polls, sum.poll_hits,
+		       (unsigned long long)sum.poll_time,
+		       sum.nr[0], (unsigned long long)
+		       (sum.nr[0] ? div64_u64(sum.time[0], sum.nr[0]) : 0),
+		       sum.nr[1], (unsigned long long)
+		       (sum.nr[1] ? div64_u64(sum.time[1], sum.nr[1]) : 0));
+}
+
+static ssize_t queue_lat_hist_show(struct request_queue *q, char *page)
+{
+	static const char *const op_names[BLK_LAT_OPS] = {
+		[BLK_LAT_READ]		= "read",
+		[BLK_LAT_WRITE]		= "write",
+		[BLK_LAT_SYNC]		= "sync",
+		[BLK_LAT_DISCARD]	= "discard",
+	};
+	static const char *const size_names[BLK_LAT_SIZES] = {
+		"4k", "32k", "256k", "max",
+	};
+	unsigned long nr[BLK_LAT_BUCKETS];
+	int op, size, cpu, i, last;
+	ssize_t len = 0;
+
+	for (op = 0; op < BLK_LAT_OPS; op++) {
+		for (size = 0; size < BLK_LAT_SIZES; size++) {
+			memset(nr, 0, sizeof(nr));
+			for_each_possible_cpu(cpu) {
+				struct blk_lat_hist *h;
+
+				h = per_cpu_ptr(q->lat_hist, cpu);
+				for (i = 0; i < BLK_LAT_BUCKETS; i++)
+					nr[i] += h->nr[op][size][i];
+			}
+
+			/* Leave out trailing empty buckets and unused rows */
+			for (last = BLK_LAT_BUCKETS - 1; last >= 0; last--)
+				if (nr[last])
+					break;
+			if (last < 0)
+				continue;
+
+			len += scnprintf(page + len, PAGE_SIZE - len, "%s %s",
+					 op_names[op], size_names[size]);
+			for (i = 0; i <= last; i++)
+				len += scnprintf(page + len, PAGE_SIZE - len,
+						 " %lu", nr[i]);
+			len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+		}
+	}
+
+	return len;
+}
+
 static ssize_t queue_nomerges_show(struct request_queue *q, char *page)
 {
 	return queue_var_show((blk_queue_nomerges(q) << 1) |
@@ -379,6 +488,22 @@ static struct queue_sysfs_entry queue_random_entry = {
 	.store = queue_store_random,
 };
 
+static struct queue_sysfs_entry queue_lat_hist_entry = {
+	.attr = {.name = "io_latency_hist", .mode = S_IRUGO },
+	.show = queue_lat_hist_show,
+};
+
+static struct queue_sysfs_entry queue_poll_entry = {
+	.attr = {.name = "io_poll", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_poll_show,
+	.store = queue_poll_store,
+};
+
+static struct queue_sysfs_entry queue_poll_stats_entry = {
+	.attr = {.name = "io_poll_stats", .mode = S_IRUGO },
+	.show = queue_poll_stats_show,
+};
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -401,6 +526,9 @@ static struct attribute *default_attrs[] = {
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
+	&queue_lat_hist_entry.attr,
+	&queue_poll_entry.attr,
+	&queue_poll_stats_entry.attr,
 	NULL,
 };
 
@@ -471,8 +599,14 @@ static void blk_release_queue(struct kobject *kobj)
 
 	blk_sync_queue(q);
 
+	if (q->mq_ops)
+		blk_mq_free_queue(q);
+
 	blk_throtl_exit(q);
 
+	free_percpu(q->poll_stat);
+	free_percpu(q->lat_hist);
+
 	if (rl->rq_pool)
 		mempool_destroy(rl->rq_pool);
 
@@ -11,6 +11,48 @@ extern struct kmem_cache *blk_requestq_cachep;
 extern struct kobj_type blk_queue_ktype;
 
 void init_request_from_bio(struct request *req, struct bio *bio);
+void drive_stat_acct(struct request *rq, int new_io);
+void blk_account_io_done(struct request *req);
+bool blk_attempt_plug_merge(struct task_struct *tsk, struct request_queue *q,
+			    struct bio *bio);
+void blk_add_plug_request(struct blk_plug *plug, struct request *req);
+
+/*
+ * Dispatch to completion latency, for the histograms of q->lat_hist and
+ * the polling statistics of queues that can be polled.  blk_poll_queue
+ * is the queue the current cpu is polling, requests it completes outside
+ * of interrupts are accounted as polled.
+ */
+DECLARE_PER_CPU(struct request_queue *, blk_poll_queue);
+
+static inline unsigned char blk_lat_size(unsigned int bytes)
+{
+	if (bytes <= 4096)
+		return 0;
+	if (bytes <= 32768)
+		return 1;
+	if (bytes <= 262144)
+		return 2;
+	return 3;
+}
+
+static inline void blk_account_io_issue(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	if (q->lat_hist || q->poll_stat) {
+		rq->issue_time = ktime_to_ns(ktime_get());
+		rq->issue_size = blk_lat_size(blk_rq_bytes(rq));
+	}
+}
+
+void __blk_account_io_latency(struct request *rq);
+
+static inline void blk_account_io_latency(struct request *rq)
+{
+	if (rq->issue_time)
+		__blk_account_io_latency(rq);
+}
 void blk_rq_bio_prep(struct request_queue *q, struct request *rq,
 			struct bio *bio);
 int blk_rq_append_bio(struct request_queue *q, struct request *rq,
@@ -107,6 +149,7 @@ int ll_back_merge_fn(struct request_queue *q, struct request *req,
 		     struct bio *bio);
 int ll_front_merge_fn(struct request_queue *q, struct request *req, 
 		      struct bio *bio);
+int elv_try_merge(struct request *__rq, struct bio *bio);
 int attempt_back_merge(struct request_queue *q, struct request *rq);
 int attempt_front_merge(struct request_queue *q, struct request *rq);
 void blk_recalc_rq_segments(struct request *rq);
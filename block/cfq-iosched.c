@@ -182,6 +182,11 @@ struct cfq_group {
 	unsigned int weight;
 	bool on_st;
 
+	/* latency target in jiffies, 0 for the device's target_latency */
+	unsigned int latency_target;
+	/* latency target mode: when the waiting group is due for service */
+	unsigned long deadline;
+
 	/* number of cfqq currently on this group */
 	int nr_cfqq;
 
@@ -288,6 +293,11 @@ struct cfq_data {
 	unsigned int cfq_group_idle;
 	unsigned int cfq_latency;
 	unsigned int cfq_group_isolation;
+	unsigned int cfq_target_latency;
+	unsigned int cfq_latency_targets;
+
+	/* completed requests that took longer than their group's target */
+	unsigned long nr_target_missed;
 
 	unsigned int cic_index;
 	struct list_head cic_list;
@@ -602,7 +612,22 @@ cfq_group_slice(struct cfq_data *cfqd, struct cfq_group *cfqg)
 {
 	struct cfq_rb_root *st = &cfqd->grp_service_tree;
 
-	return cfq_target_latency * cfqg->weight / st->total_weight;
+	return cfqd->cfq_target_latency * cfqg->weight / st->total_weight;
+}
+
+static inline unsigned int
+cfq_group_target(struct cfq_data *cfqd, struct cfq_group *cfqg)
+{
+	return cfqg->latency_target ? : cfqd->cfq_target_latency;
+}
+
+/*
+ * In latency target mode, don't idle on non-rotational devices. Without
+ * seeks to save, idling only holds back the other groups' requests.
+ */
+static inline bool cfq_idling_disabled(struct cfq_data *cfqd)
+{
+	return cfqd->cfq_latency_targets && blk_queue_nonrot(cfqd->queue);
 }
 
 static inline void
@@ -886,6 +911,7 @@ cfq_group_service_tree_add(struct cfq_data *cfqd, struct cfq_group *cfqg)
 
 	__cfq_group_service_tree_add(st, cfqg);
 	cfqg->on_st = true;
+	cfqg->deadline = jiffies + cfq_group_target(cfqd, cfqg);
 	st->total_weight += cfqg->weight;
 }
 
@@ -959,6 +985,7 @@ static void cfq_group_served(struct cfq_data *cfqd, struct cfq_group *cfqg,
 	cfq_rb_erase(&cfqg->rb_node, st);
 	cfqg->vdisktime += cfq_scale_slice(charge, cfqg);
 	__cfq_group_service_tree_add(st, cfqg);
+	cfqg->deadline = jiffies + cfq_group_target(cfqd, cfqg);
 
 	/* This group is being expired. Save the context */
 	if (time_after(cfqd->workload_expires, jiffies)) {
@@ -992,6 +1019,12 @@ void cfq_update_blkio_group_weight(void *key, struct blkio_group *blkg,
 	cfqg_of_blkg(blkg)->weight = weight;
 }
 
+void cfq_update_blkio_group_latency_target(void *key, struct blkio_group *blkg,
+					   unsigned int latency_target)
+{
+	cfqg_of_blkg(blkg)->latency_target = msecs_to_jiffies(latency_target);
+}
+
 static struct cfq_group *
 cfq_find_alloc_cfqg(struct cfq_data *cfqd, struct cgroup *cgroup, int create)
 {
@@ -1043,6 +1076,7 @@ cfq_find_alloc_cfqg(struct cfq_data *cfqd, struct cgroup *cgroup, int create)
 					0);
 
 	cfqg->weight = blkcg_get_weight(blkcg, cfqg->blkg.dev);
+	cfqg->latency_target = msecs_to_jiffies(blkcg->latency_target);
 
 	/* Add group on cfqd list */
 	hlist_add_head(&cfqg->cfqd_node, &cfqd->cfqg_list);
@@ -1884,7 +1918,7 @@ static bool cfq_should_idle(struct cfq_data *cfqd, struct cfq_queue *cfqq)
 	BUG_ON(!service_tree);
 	BUG_ON(!service_tree->count);
 
-	if (!cfqd->cfq_slice_idle)
+	if (!cfqd->cfq_slice_idle || cfq_idling_disabled(cfqd))
 		return false;
 
 	/* We never do for idle class queues. */
@@ -1918,7 +1952,8 @@ static void cfq_arm_slice_timer(struct cfq_data *cfqd)
 	 * for devices that support queuing, otherwise we still have a problem
 	 * with sync vs async workloads.
 	 */
-	if (blk_queue_nonrot(cfqd->queue) && cfqd->hw_tag)
+	if ((blk_queue_nonrot(cfqd->queue) && cfqd->hw_tag) ||
+	    cfq_idling_disabled(cfqd))
 		return;
 
 	WARN_ON(!RB_EMPTY_ROOT(&cfqq->sort_list));
@@ -2175,7 +2210,8 @@ static void choose_service_tree(struct cfq_data *cfqd, struct cfq_group *cfqg)
 		 * to have higher weight. A more accurate thing would be to
 		 * calculate system wide asnc/sync ratio.
 		 */
-		tmp = cfq_target_latency * cfqg_busy_async_queues(cfqd, cfqg);
+		tmp = cfqd->cfq_target_latency *
+			cfqg_busy_async_queues(cfqd, cfqg);
 		tmp = tmp/cfqd->busy_queues;
 		slice = min_t(unsigned, slice, tmp);
 
@@ -2191,14 +2227,54 @@ static void choose_service_tree(struct cfq_data *cfqd, struct cfq_group *cfqg)
 	cfqd->workload_expires = jiffies + slice;
 }
 
+/*
+ * Latency target mode: of the busy groups other than @skip that are due,
+ * return the one with the earliest deadline.  A group is due once it has
+ * waited for half its latency target, or with @late, all of it.
+ */
+static struct cfq_group *
+cfq_due_cfqg(struct cfq_data *cfqd, struct cfq_group *skip, bool late)
+{
+	struct cfq_rb_root *st = &cfqd->grp_service_tree;
+	struct cfq_group *cfqg, *due = NULL;
+	struct rb_node *n;
+
+	for (n = rb_first(&st->rb); n; n = rb_next(n)) {
+		unsigned long when;
+
+		cfqg = rb_entry_cfqg(n);
+		if (cfqg == skip)
+			continue;
+
+		when = cfqg->deadline;
+		if (!late)
+			when -= cfq_group_target(cfqd, cfqg) / 2;
+		if (time_before(jiffies, when))
+			continue;
+
+		if (!due || time_before(cfqg->deadline, due->deadline))
+			due = cfqg;
+	}
+
+	return due;
+}
+
 static struct cfq_group *cfq_get_next_cfqg(struct cfq_data *cfqd)
 {
 	struct cfq_rb_root *st = &cfqd->grp_service_tree;
-	struct cfq_group *cfqg;
+	struct cfq_group *cfqg = NULL;
 
 	if (RB_EMPTY_ROOT(&st->rb))
 		return NULL;
-	cfqg = cfq_rb_first_group(st);
+
+	/*
+	 * Groups are served in vdisktime order, so in proportion to their
+	 * weights, unless one is close to missing its latency target.
+	 */
+	if (cfqd->cfq_latency_targets)
+		cfqg = cfq_due_cfqg(cfqd, NULL, false);
+	if (!cfqg)
+		cfqg = cfq_rb_first_group(st);
 	st->active = &cfqg->rb_node;
 	update_min_vdisktime(st);
 	return cfqg;
@@ -2236,6 +2312,13 @@ static struct cfq_queue *cfq_select_queue(struct cfq_data *cfqd)
 	if (!cfqd->rq_queued)
 		return NULL;
 
+	/*
+	 * In latency target mode, a group that has waited for all of its
+	 * target preempts the one being served.
+	 */
+	if (cfqd->cfq_latency_targets && cfq_due_cfqg(cfqd, cfqq->cfqg, true))
+		goto expire;
+
 	/*
 	 * We were waiting for group to get backlogged. Expire the queue
 	 */
@@ -2303,8 +2386,8 @@ static struct cfq_queue *cfq_select_queue(struct cfq_data *cfqd)
 	 * this group, wait for requests to complete.
 	 */
 check_group_idle:
-	if (cfqd->cfq_group_idle && cfqq->cfqg->nr_cfqq == 1
-	    && cfqq->cfqg->dispatched) {
+	if (cfqd->cfq_group_idle && !cfq_idling_disabled(cfqd)
+	    && cfqq->cfqg->nr_cfqq == 1 && cfqq->cfqg->dispatched) {
 		cfqq = NULL;
 		goto keep_queue;
 	}
@@ -3420,6 +3503,9 @@ static bool cfq_should_wait_busy(struct cfq_data *cfqd, struct cfq_queue *cfqq)
 	if (cfqq->cfqg->nr_cfqq > 1)
 		return false;
 
+	if (cfq_idling_disabled(cfqd))
+		return false;
+
 	if (cfq_slice_used(cfqq))
 		return true;
 
@@ -3445,6 +3531,7 @@ static void cfq_completed_request(struct request_queue *q, struct request *rq)
 {
 	struct cfq_queue *cfqq = RQ_CFQQ(rq);
 	struct cfq_data *cfqd = cfqq->cfqd;
+	struct cfq_group *cfqg = RQ_CFQG(rq);
 	const int sync = rq_is_sync(rq);
 	unsigned long now;
 
@@ -3465,6 +3552,12 @@ static void cfq_completed_request(struct request_queue *q, struct request *rq)
 
 	cfqd->rq_in_flight[cfq_cfqq_sync(cfqq)]--;
 
+	if (time_after(now, rq->start_time + cfq_group_target(cfqd, cfqg))) {
+		cfqd->nr_target_missed++;
+		cfq_blkiocg_update_target_missed_stats(&cfqg->blkg,
+				rq_data_dir(rq), rq_is_sync(rq));
+	}
+
 	if (sync) {
 		RQ_CIC(rq)->last_end_request = now;
 		if (!time_after(rq->start_time + cfqd->cfq_fifo_expire[1], now))
@@ -3890,6 +3983,8 @@ static void *cfq_init_queue(struct request_queue *q)
 	cfq_blkiocg_add_blkio_group(&blkio_root_cgroup, &cfqg->blkg,
 					(void *)cfqd, 0);
 	rcu_read_unlock();
+	cfqg->latency_target =
+		msecs_to_jiffies(blkio_root_cgroup.latency_target);
 #endif
 	/*
 	 * Not strictly needed (since RB_ROOT just clears the node and we
@@ -3930,6 +4025,8 @@ static void *cfq_init_queue(struct request_queue *q)
 	cfqd->cfq_group_idle = cfq_group_idle;
 	cfqd->cfq_latency = 1;
 	cfqd->cfq_group_isolation = 0;
+	cfqd->cfq_target_latency = cfq_target_latency;
+	cfqd->cfq_latency_targets = 0;
 	cfqd->hw_tag = -1;
 	/*
 	 * we optimistically start assuming sync ops weren't delayed in last
@@ -4006,8 +4103,17 @@ SHOW_FUNCTION(cfq_slice_async_show, cfqd->cfq_slice[0], 1);
 SHOW_FUNCTION(cfq_slice_async_rq_show, cfqd->cfq_slice_async_rq, 0);
 SHOW_FUNCTION(cfq_low_latency_show, cfqd->cfq_latency, 0);
 SHOW_FUNCTION(cfq_group_isolation_show, cfqd->cfq_group_isolation, 0);
+SHOW_FUNCTION(cfq_target_latency_show, cfqd->cfq_target_latency, 1);
+SHOW_FUNCTION(cfq_latency_targets_show, cfqd->cfq_latency_targets, 0);
 #undef SHOW_FUNCTION
 
+static ssize_t cfq_target_missed_show(struct elevator_queue *e, char *page)
+{
+	struct cfq_data *cfqd = e->elevator_data;
+
+	return sprintf(page, "%lu\n", cfqd->nr_target_missed);
+}
+
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
 static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
 {									\
@@ -4040,6 +4146,9 @@ STORE_FUNCTION(cfq_slice_async_rq_store, &cfqd->cfq_slice_async_rq, 1,
 		UINT_MAX, 0);
 STORE_FUNCTION(cfq_low_latency_store, &cfqd->cfq_latency, 0, 1, 0);
 STORE_FUNCTION(cfq_group_isolation_store, &cfqd->cfq_group_isolation, 0, 1, 0);
+STORE_FUNCTION(cfq_target_latency_store, &cfqd->cfq_target_latency, 1,
+		UINT_MAX, 1);
+STORE_FUNCTION(cfq_latency_targets_store, &cfqd->cfq_latency_targets, 0, 1, 0);
 #undef STORE_FUNCTION
 
 #define CFQ_ATTR(name) \
@@ -4058,6 +4167,9 @@ static struct elv_fs_entry cfq_attrs[] = {
 	CFQ_ATTR(group_idle),
 	CFQ_ATTR(low_latency),
 	CFQ_ATTR(group_isolation),
+	CFQ_ATTR(target_latency),
+	CFQ_ATTR(latency_targets),
+	__ATTR(target_missed, S_IRUGO, cfq_target_missed_show, NULL),
 	__ATTR_NULL
 };
 
@@ -4093,6 +4205,8 @@ static struct blkio_policy_type blkio_policy_cfq = {
 	.ops = {
 		.blkio_unlink_group_fn =	cfq_unlink_blkio_group,
 		.blkio_update_group_weight_fn =	cfq_update_blkio_group_weight,
+		.blkio_update_group_latency_target_fn =
+					cfq_update_blkio_group_latency_target,
 	},
 	.plid = BLKIO_POLICY_PROP,
 };
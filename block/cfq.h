@@ -38,6 +38,12 @@ static inline void cfq_blkiocg_update_io_merged_stats(struct blkio_group *blkg,
 	blkiocg_update_io_merged_stats(blkg, direction, sync);
 }
 
+static inline void cfq_blkiocg_update_target_missed_stats(
+		struct blkio_group *blkg, bool direction, bool sync)
+{
+	blkiocg_update_target_missed_stats(blkg, direction, sync);
+}
+
 static inline void cfq_blkiocg_update_idle_time_stats(struct blkio_group *blkg)
 {
 	blkiocg_update_idle_time_stats(blkg);
@@ -91,6 +97,8 @@ static inline void cfq_blkiocg_update_io_remove_stats(struct blkio_group *blkg,
 				bool direction, bool sync) {}
 static inline void cfq_blkiocg_update_io_merged_stats(struct blkio_group *blkg,
 		bool direction, bool sync) {}
+static inline void cfq_blkiocg_update_target_missed_stats(
+		struct blkio_group *blkg, bool direction, bool sync) {}
 static inline void cfq_blkiocg_update_idle_time_stats(struct blkio_group *blkg)
 {
 }
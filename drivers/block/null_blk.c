@@ -0,0 +1,366 @@
+/*
+ * Null block device driver
+ *
+ * Completes every I/O as soon as it is queued without touching any
+ * data, so that the overhead of the block layer itself can be measured.
+ * The queue_mode parameter selects how the devices are driven:
+ *
+ *   0: bio based, ->make_request_fn ends the bios directly
+ *   1: single queue, ->request_fn behind the elevator and queue_lock
+ *   2: multiqueue, per-cpu software queues on submit_queues hardware
+ *      queues (the default)
+ *
+ * In multiqueue mode, irqmode=1 defers each completion by completion_nsec
+ * to a per hardware queue hrtimer, standing in for a device interrupt.
+ * Such completions can also be reaped by polling, see blk_poll().
+ */
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/bio.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+
+enum {
+	NULL_Q_BIO	= 0,
+	NULL_Q_RQ	= 1,
+	NULL_Q_MQ	= 2,
+
+	NULL_IRQ_NONE	= 0,
+	NULL_IRQ_TIMER	= 1,
+};
+
+/* Driver data of a request in NULL_IRQ_TIMER mode */
+struct nullb_cmd {
+	struct list_head	list;
+	ktime_t			deadline;
+};
+
+/* A hardware queue in NULL_IRQ_TIMER mode */
+struct nullb_queue {
+	spinlock_t		lock;
+	struct list_head	pending;	/* in order of deadline */
+	struct hrtimer		timer;
+	bool			timer_armed;
+};
+
+struct nullb {
+	struct list_head	list;
+	unsigned int		index;
+	struct request_queue	*q;
+	struct gendisk		*disk;
+	spinlock_t		lock;		/* queue_lock in NULL_Q_RQ mode */
+	struct nullb_queue	*queues;
+};
+
+static LIST_HEAD(nullb_list);
+static int null_major;
+static int nullb_indexes;
+
+static int queue_mode = NULL_Q_MQ;
+module_param(queue_mode, int, S_IRUGO);
+MODULE_PARM_DESC(queue_mode, "Block interface: 0 bio, 1 request, 2 multiqueue");
+
+static int submit_queues;
+module_param(submit_queues, int, S_IRUGO);
+MODULE_PARM_DESC(submit_queues, "Hardware queues in multiqueue mode, default one per online cpu");
+
+static int hw_queue_depth = 64;
+module_param(hw_queue_depth, int, S_IRUGO);
+MODULE_PARM_DESC(hw_queue_depth, "Queue depth of each hardware queue");
+
+static int nr_devices = 2;
+module_param(nr_devices, int, S_IRUGO);
+MODULE_PARM_DESC(nr_devices, "Number of devices to register");
+
+static int gb = 250;
+module_param(gb, int, S_IRUGO);
+MODULE_PARM_DESC(gb, "Size in GB");
+
+static int bs = 512;
+module_param(bs, int, S_IRUGO);
+MODULE_PARM_DESC(bs, "Block size in bytes");
+
+static int irqmode = NULL_IRQ_NONE;
+module_param(irqmode, int, S_IRUGO);
+MODULE_PARM_DESC(irqmode, "Multiqueue completions: 0 inline, 1 timer");
+
+static unsigned long completion_nsec = 10000;
+module_param(completion_nsec, ulong, S_IRUGO);
+MODULE_PARM_DESC(completion_nsec, "Completion delay in timer mode, in ns");
+
+static int null_make_request(struct request_queue *q, struct bio *bio)
+{
+	bio_endio(bio, 0);
+	return 0;
+}
+
+static void null_request_fn(struct request_queue *q)
+{
+	struct request *rq;
+
+	while ((rq = blk_fetch_request(q)) != NULL)
+		__blk_end_request_all(rq, 0);
+}
+
+/*
+ * Complete the requests whose deadline has passed.  Returns how many
+ * were completed and, through @next, the deadline of the first one left.
+ */
+static int null_reap(struct nullb_queue *nq, ktime_t *next)
+{
+	ktime_t now = ktime_get();
+	struct nullb_cmd *cmd, *tmp;
+	unsigned long flags;
+	LIST_HEAD(done);
+	int found = 0;
+
+	spin_lock_irqsave(&nq->lock, flags);
+	list_for_each_entry_safe(cmd, tmp, &nq->pending, list) {
+		if (cmd->deadline.tv64 > now.tv64) {
+			if (next)
+				*next = cmd->deadline;
+			break;
+		}
+		list_move_tail(&cmd->list, &done);
+		found++;
+	}
+	if (next && list_empty(&nq->pending))
+		nq->timer_armed = false;
+	spin_unlock_irqrestore(&nq->lock, flags);
+
+	list_for_each_entry_safe(cmd, tmp, &done, list) {
+		list_del(&cmd->list);
+		blk_mq_end_io(blk_mq_rq_from_pdu(cmd), 0);
+	}
+
+	return found;
+}
+
+static enum hrtimer_restart null_timer_fn(struct hrtimer *timer)
+{
+	struct nullb_queue *nq = container_of(timer, struct nullb_queue, timer);
+	ktime_t next = { .tv64 = 0 };
+
+	null_reap(nq, &next);
+	if (!next.tv64)
+		return HRTIMER_NORESTART;
+
+	hrtimer_set_expires(timer, next);
+	return HRTIMER_RESTART;
+}
+
+static int null_queue_rq(struct blk_mq_hw_ctx *hctx, struct request *rq,
+			 bool last)
+{
+	struct nullb_queue *nq = hctx->driver_data;
+	struct nullb_cmd *cmd = blk_mq_rq_to_pdu(rq);
+	unsigned long flags;
+
+	if (irqmode == NULL_IRQ_NONE) {
+		blk_mq_end_io(rq, 0);
+		return BLK_MQ_RQ_QUEUE_OK;
+	}
+
+	cmd->deadline = ktime_add_ns(ktime_get(), completion_nsec);
+
+	spin_lock_irqsave(&nq->lock, flags);
+	list_add_tail(&cmd->list, &nq->pending);
+	if (!nq->timer_armed) {
+		nq->timer_armed = true;
+		hrtimer_start(&nq->timer, cmd->deadline, HRTIMER_MODE_ABS);
+	}
+	spin_unlock_irqrestore(&nq->lock, flags);
+
+	return BLK_MQ_RQ_QUEUE_OK;
+}
+
+static int null_poll(struct blk_mq_hw_ctx *hctx)
+{
+	return null_reap(hctx->driver_data, NULL);
+}
+
+static int null_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
+			  unsigned int index)
+{
+	struct nullb *nullb = data;
+	struct nullb_queue *nq = &nullb->queues[index];
+
+	spin_lock_init(&nq->lock);
+	INIT_LIST_HEAD(&nq->pending);
+	hrtimer_init(&nq->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	nq->timer.function = null_timer_fn;
+
+	hctx->driver_data = nq;
+	return 0;
+}
+
+static void null_exit_hctx(struct blk_mq_hw_ctx *hctx, unsigned int index)
+{
+	struct nullb_queue *nq = hctx->driver_data;
+
+	hrtimer_cancel(&nq->timer);
+}
+
+static struct blk_mq_ops null_mq_ops = {
+	.queue_rq	= null_queue_rq,
+	.init_hctx	= null_init_hctx,
+	.exit_hctx	= null_exit_hctx,
+};
+
+static struct blk_mq_reg null_mq_reg = {
+	.ops		= &null_mq_ops,
+	.numa_node	= NUMA_NO_NODE,
+};
+
+static const struct block_device_operations null_fops = {
+	.owner		= THIS_MODULE,
+};
+
+static int null_add_dev(void)
+{
+	struct gendisk *disk;
+	struct nullb *nullb;
+	sector_t size;
+
+	nullb = kzalloc(sizeof(*nullb), GFP_KERNEL);
+	if (!nullb)
+		return -ENOMEM;
+
+	spin_lock_init(&nullb->lock);
+
+	switch (queue_mode) {
+	case NULL_Q_MQ:
+		nullb->queues = kcalloc(submit_queues,
+					sizeof(struct nullb_queue), GFP_KERNEL);
+		if (!nullb->queues)
+			goto out_free;
+
+		null_mq_reg.nr_hw_queues = submit_queues;
+		null_mq_reg.queue_depth = hw_queue_depth;
+		if (irqmode == NULL_IRQ_TIMER) {
+			null_mq_reg.cmd_size = sizeof(struct nullb_cmd);
+			null_mq_ops.poll = null_poll;
+		}
+		nullb->q = blk_mq_init_queue(&null_mq_reg, nullb);
+		break;
+	case NULL_Q_BIO:
+		nullb->q = blk_alloc_queue(GFP_KERNEL);
+		if (nullb->q)
+			blk_queue_make_request(nullb->q, null_make_request);
+		break;
+	default:
+		nullb->q = blk_init_queue(null_request_fn, &nullb->lock);
+		break;
+	}
+	if (!nullb->q)
+		goto out_free;
+
+	nullb->q->queuedata = nullb;
+	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, nullb->q);
+
+	disk = nullb->disk = alloc_disk(1);
+	if (!disk)
+		goto out_cleanup_queue;
+
+	nullb->index = nullb_indexes++;
+	list_add_tail(&nullb->list, &nullb_list);
+
+	blk_queue_logical_block_size(nullb->q, bs);
+	blk_queue_physical_block_size(nullb->q, bs);
+
+	size = (sector_t) gb * 1024 * 1024 * 1024ULL;
+	sector_div(size, bs);
+	set_capacity(disk, size * (bs >> 9));
+
+	disk->major = null_major;
+	disk->first_minor = nullb->index;
+	disk->fops = &null_fops;
+	disk->private_data = nullb;
+	disk->queue = nullb->q;
+	sprintf(disk->disk_name, "nullb%d", nullb->index);
+	add_disk(disk);
+	return 0;
+
+out_cleanup_queue:
+	blk_cleanup_queue(nullb->q);
+out_free:
+	kfree(nullb->queues);
+	kfree(nullb);
+	return -ENOMEM;
+}
+
+static void null_del_dev(struct nullb *nullb)
+{
+	list_del(&nullb->list);
+	del_gendisk(nullb->disk);
+	blk_cleanup_queue(nullb->q);
+	put_disk(nullb->disk);
+	kfree(nullb->queues);
+	kfree(nullb);
+}
+
+static int __init null_init(void)
+{
+	struct nullb *nullb;
+	int i, ret;
+
+	if (bs < 512 || bs > PAGE_SIZE || !is_power_of_2(bs)) {
+		pr_warning("null_blk: invalid block size %d, using 512\n", bs);
+		bs = 512;
+	}
+
+	if (queue_mode == NULL_Q_MQ) {
+		if (submit_queues <= 0 || submit_queues > nr_cpu_ids)
+			submit_queues = num_online_cpus();
+		if (hw_queue_depth <= 0 || hw_queue_depth > BLK_MQ_MAX_DEPTH)
+			hw_queue_depth = 64;
+	} else if (queue_mode != NULL_Q_BIO && queue_mode != NULL_Q_RQ) {
+		pr_warning("null_blk: invalid queue_mode %d, using %d\n",
+			   queue_mode, NULL_Q_MQ);
+		queue_mode = NULL_Q_MQ;
+		submit_queues = num_online_cpus();
+	}
+
+	null_major = register_blkdev(0, "nullb");
+	if (null_major < 0)
+		return null_major;
+
+	for (i = 0; i < nr_devices; i++) {
+		ret = null_add_dev();
+		if (ret)
+			goto err_dev;
+	}
+
+	pr_info("null_blk: module loaded\n");
+	return 0;
+
+err_dev:
+	while (!list_empty(&nullb_list)) {
+		nullb = list_entry(nullb_list.next, struct nullb, list);
+		null_del_dev(nullb);
+	}
+	unregister_blkdev(null_major, "nullb");
+	return ret;
+}
+
+static void __exit null_exit(void)
+{
+	struct nullb *nullb;
+
+	while (!list_empty(&nullb_list)) {
+		nullb = list_entry(nullb_list.next, struct nullb, list);
+		null_del_dev(nullb);
+	}
+	unregister_blkdev(null_major, "nullb");
+}
+
+module_init(null_init);
+module_exit(null_exit);
+
+MODULE_DESCRIPTION("Null block device driver");
+MODULE_LICENSE("GPL");
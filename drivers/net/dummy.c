@@ -39,6 +39,7 @@
 #include <linux/u64_stats_sync.h>
 
 static int numdummies = 1;
+static int numtxqs = 1;
 
 static int dummy_set_address(struct net_device *dev, void *p)
 {
@@ -149,22 +150,36 @@ static int dummy_validate(struct nlattr *tb[], struct nlattr *data[])
 	return 0;
 }
 
+static int dummy_get_tx_queues(struct net *net, struct nlattr *tb[],
+			       unsigned int *num_tx_queues,
+			       unsigned int *real_num_tx_queues)
+{
+	*num_tx_queues = numtxqs;
+	*real_num_tx_queues = numtxqs;
+	return 0;
+}
+
 static struct rtnl_link_ops dummy_link_ops __read_mostly = {
 	.kind		= "dummy",
 	.setup		= dummy_setup,
 	.validate	= dummy_validate,
+	.get_tx_queues	= dummy_get_tx_queues,
 };
 
 /* Number of dummy devices to be set up by this module. */
 module_param(numdummies, int, 0);
 MODULE_PARM_DESC(numdummies, "Number of dummy pseudo devices");
 
+/* Number of TX queues per device, to exercise multiqueue transmit. */
+module_param(numtxqs, int, 0);
+MODULE_PARM_DESC(numtxqs, "Number of TX queues per dummy device");
+
 static int __init dummy_init_one(void)
 {
 	struct net_device *dev_dummy;
 	int err;
 
-	dev_dummy = alloc_netdev(0, "dummy%d", dummy_setup);
+	dev_dummy = alloc_netdev_mq(0, "dummy%d", dummy_setup, numtxqs);
 	if (!dev_dummy)
 		return -ENOMEM;
 
@@ -187,6 +202,9 @@ static int __init dummy_init_module(void)
 {
 	int i, err = 0;
 
+	if (numtxqs < 1)
+		return -EINVAL;
+
 	rtnl_lock();
 	err = __rtnl_link_register(&dummy_link_ops);
 
@@ -26,6 +26,7 @@
 #include <linux/scatterlist.h>
 #include <linux/if_vlan.h>
 #include <linux/slab.h>
+#include <net/busy_poll.h>
 
 static int napi_weight = 128;
 module_param(napi_weight, int, 0444);
@@ -47,6 +48,9 @@ struct virtnet_info {
 	struct napi_struct napi;
 	unsigned int status;
 
+	/* The transmit interrupt fired, reap sent buffers in virtnet_poll */
+	bool tx_done;
+
 	/* Number of input buffers, and max we've ever had. */
 	unsigned int num, max;
 
@@ -124,8 +128,13 @@ static void skb_xmit_done(struct virtqueue *svq)
 	/* Suppress further interrupts. */
 	virtqueue_disable_cb(svq);
 
-	/* We were probably waiting for more output buffers. */
-	netif_wake_queue(vi->dev);
+	/*
+	 * The sent buffers have to be reaped under the tx lock before the
+	 * queue can go on, as their completion is what lifts a stop by the
+	 * byte queue limits.  Leave that to virtnet_poll.
+	 */
+	vi->tx_done = true;
+	napi_schedule(&vi->napi);
 }
 
 static void set_skb_frag(struct sk_buff *skb, struct page *page,
@@ -315,6 +324,7 @@ static void receive_buf(struct net_device *dev, void *buf, unsigned int len)
 		skb_shinfo(skb)->gso_segs = 0;
 	}
 
+	skb_mark_napi_id(skb, &vi->napi);
 	netif_receive_skb(skb);
 	return;
 
@@ -476,6 +486,20 @@ static void refill_work(struct work_struct *work)
 		schedule_delayed_work(&vi->refill, HZ/2);
 }
 
+static unsigned int free_old_xmit_skbs(struct virtnet_info *vi);
+
+static void virtnet_tx_complete(struct virtnet_info *vi)
+{
+	struct netdev_queue *txq = netdev_get_tx_queue(vi->dev, 0);
+
+	__netif_tx_lock(txq, smp_processor_id());
+	free_old_xmit_skbs(vi);
+	__netif_tx_unlock(txq);
+
+	/* We were probably waiting for more output buffers. */
+	netif_wake_queue(vi->dev);
+}
+
 static int virtnet_poll(struct napi_struct *napi, int budget)
 {
 	struct virtnet_info *vi = container_of(napi, struct virtnet_info, napi);
@@ -483,6 +507,12 @@ static int virtnet_poll(struct napi_struct *napi, int budget)
 	unsigned int len, received = 0;
 
 again:
+	if (vi->tx_done) {
+		vi->tx_done = false;
+		smp_mb();
+		virtnet_tx_complete(vi);
+	}
+
 	while (received < budget &&
 	       (buf = virtqueue_get_buf(vi->rvq, &len)) != NULL) {
 		receive_buf(vi->dev, buf, len);
@@ -498,7 +528,7 @@ again:
 	/* Out of packets? */
 	if (received < budget) {
 		napi_complete(napi);
-		if (unlikely(!virtqueue_enable_cb(vi->rvq)) &&
+		if (unlikely(!virtqueue_enable_cb(vi->rvq) || vi->tx_done) &&
 		    napi_schedule_prep(napi)) {
 			virtqueue_disable_cb(vi->rvq);
 			__napi_schedule(napi);
@@ -513,14 +543,18 @@ static unsigned int free_old_xmit_skbs(struct virtnet_info *vi)
 {
 	struct sk_buff *skb;
 	unsigned int len, tot_sgs = 0;
+	unsigned int pkts = 0, bytes = 0;
 
 	while ((skb = virtqueue_get_buf(vi->svq, &len)) != NULL) {
 		pr_debug("Sent skb %p\n", skb);
 		vi->dev->stats.tx_bytes += skb->len;
 		vi->dev->stats.tx_packets++;
+		bytes += skb->len;
+		pkts++;
 		tot_sgs += skb_vnet_hdr(skb)->num_sg;
 		dev_kfree_skb_any(skb);
 	}
+	netdev_completed_queue(vi->dev, pkts, bytes);
 	return tot_sgs;
 }
 
@@ -574,6 +608,7 @@ static int xmit_skb(struct virtnet_info *vi, struct sk_buff *skb)
 static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct virtnet_info *vi = netdev_priv(dev);
+	struct netdev_queue *txq = netdev_get_tx_queue(dev, 0);
 	int capacity;
 
 	/* Free up any pending old buffers before queueing new ones. */
@@ -599,6 +634,7 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 		kfree_skb(skb);
 		return NETDEV_TX_OK;
 	}
+	netdev_sent_queue(dev, skb->len);
 	virtqueue_kick(vi->svq);
 
 	/* Don't wait up for transmitted skbs to be freed. */
@@ -607,15 +643,18 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 
 	/* Apparently nice girls don't return TX_BUSY; stop the queue
 	 * before it gets out of hand.  Naturally, this wastes entries. */
-	if (capacity < 2+MAX_SKB_FRAGS) {
+	if (capacity < 2+MAX_SKB_FRAGS)
 		netif_stop_queue(dev);
+
+	/* Either way of stopping, only completions restart the queue. */
+	if (netif_xmit_stopped(txq)) {
 		if (unlikely(!virtqueue_enable_cb(vi->svq))) {
 			/* More just got used, free them then recheck. */
 			capacity += free_old_xmit_skbs(vi);
-			if (capacity >= 2+MAX_SKB_FRAGS) {
+			if (capacity >= 2+MAX_SKB_FRAGS)
 				netif_start_queue(dev);
+			if (!netif_xmit_stopped(txq))
 				virtqueue_disable_cb(vi->svq);
-			}
 		}
 	}
 
@@ -652,6 +691,8 @@ static int virtnet_open(struct net_device *dev)
 {
 	struct virtnet_info *vi = netdev_priv(dev);
 
+	/* A transmit interrupt may have been lost while napi was off */
+	vi->tx_done = true;
 	virtnet_napi_enable(vi);
 	return 0;
 }
@@ -941,6 +982,7 @@ static int virtnet_probe(struct virtio_device *vdev)
 	/* Set up our device-specific information */
 	vi = netdev_priv(dev);
 	netif_napi_add(dev, &vi->napi, virtnet_poll, napi_weight);
+	napi_hash_add(&vi->napi);
 	vi->dev = dev;
 	vi->vdev = vdev;
 	vdev->priv = vi;
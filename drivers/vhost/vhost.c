@@ -170,6 +170,9 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 	vq->call_ctx = NULL;
 	vq->call = NULL;
 	vq->log_ctx = NULL;
+	vq->upend_idx = 0;
+	vq->done_idx = 0;
+	vq->ubufs = NULL;
 }
 
 static int vhost_worker(void *data)
@@ -212,10 +215,20 @@ static int vhost_worker(void *data)
 	}
 }
 
+/* Bitmask of vqs, by index, that may transmit guest buffers zero copy. */
+static unsigned vhost_zcopy_mask __read_mostly;
+
+void vhost_enable_zcopy(int vq)
+{
+	vhost_zcopy_mask |= 0x1 << vq;
+}
+
 /* Helper to allocate iovec buffers for all vqs. */
 static long vhost_dev_alloc_iovecs(struct vhost_dev *dev)
 {
 	int i;
+	bool zcopy;
+
 	for (i = 0; i < dev->nvqs; ++i) {
 		dev->vqs[i].indirect = kmalloc(sizeof *dev->vqs[i].indirect *
 					       UIO_MAXIOV, GFP_KERNEL);
@@ -223,9 +236,15 @@ static long vhost_dev_alloc_iovecs(struct vhost_dev *dev)
 					  GFP_KERNEL);
 		dev->vqs[i].heads = kmalloc(sizeof *dev->vqs[i].heads *
 					    UIO_MAXIOV, GFP_KERNEL);
+		zcopy = vhost_zcopy_mask & (0x1 << i);
+		if (zcopy)
+			dev->vqs[i].ubuf_info =
+				kmalloc(sizeof *dev->vqs[i].ubuf_info *
+					UIO_MAXIOV, GFP_KERNEL);
 
 		if (!dev->vqs[i].indirect || !dev->vqs[i].log ||
-			!dev->vqs[i].heads)
+			!dev->vqs[i].heads ||
+			(zcopy && !dev->vqs[i].ubuf_info))
 			goto err_nomem;
 	}
 	return 0;
@@ -234,6 +253,8 @@ err_nomem:
 		kfree(dev->vqs[i].indirect);
 		kfree(dev->vqs[i].log);
 		kfree(dev->vqs[i].heads);
+		kfree(dev->vqs[i].ubuf_info);
+		dev->vqs[i].ubuf_info = NULL;
 	}
 	return -ENOMEM;
 }
@@ -248,6 +269,8 @@ static void vhost_dev_free_iovecs(struct vhost_dev *dev)
 		dev->vqs[i].log = NULL;
 		kfree(dev->vqs[i].heads);
 		dev->vqs[i].heads = NULL;
+		kfree(dev->vqs[i].ubuf_info);
+		dev->vqs[i].ubuf_info = NULL;
 	}
 }
 
@@ -271,6 +294,7 @@ long vhost_dev_init(struct vhost_dev *dev,
 		dev->vqs[i].log = NULL;
 		dev->vqs[i].indirect = NULL;
 		dev->vqs[i].heads = NULL;
+		dev->vqs[i].ubuf_info = NULL;
 		dev->vqs[i].dev = dev;
 		mutex_init(&dev->vqs[i].mutex);
 		vhost_vq_reset(dev, dev->vqs + i);
@@ -375,6 +399,12 @@ void vhost_dev_cleanup(struct vhost_dev *dev)
 {
 	int i;
 	for (i = 0; i < dev->nvqs; ++i) {
+		/* Wait for the lower device to release all guest buffers.
+		 * The guest is going away, so they are not signalled used. */
+		if (dev->vqs[i].ubufs) {
+			vhost_ubuf_put_and_wait(dev->vqs[i].ubufs);
+			vhost_poll_flush(&dev->vqs[i].poll);
+		}
 		if (dev->vqs[i].kick && dev->vqs[i].handle_kick) {
 			vhost_poll_stop(&dev->vqs[i].poll);
 			vhost_poll_flush(&dev->vqs[i].poll);
@@ -1390,3 +1420,73 @@ void vhost_disable_notify(struct vhost_virtqueue *vq)
 		vq_err(vq, "Failed to enable notification at %p: %d\n",
 		       &vq->used->flags, r);
 }
+
+static void vhost_zerocopy_done_signal(struct kref *kref)
+{
+	struct vhost_ubuf_ref *ubufs = container_of(kref, struct vhost_ubuf_ref,
+						    kref);
+	complete(&ubufs->done);
+}
+
+struct vhost_ubuf_ref *vhost_ubuf_alloc(struct vhost_virtqueue *vq,
+					bool zcopy)
+{
+	struct vhost_ubuf_ref *ubufs;
+	/* No zero copy backend? Nothing to count. */
+	if (!zcopy)
+		return NULL;
+	ubufs = kmalloc(sizeof *ubufs, GFP_KERNEL);
+	if (!ubufs)
+		return ERR_PTR(-ENOMEM);
+	kref_init(&ubufs->kref);
+	init_completion(&ubufs->done);
+	ubufs->vq = vq;
+	return ubufs;
+}
+
+void vhost_ubuf_put(struct vhost_ubuf_ref *ubufs)
+{
+	kref_put(&ubufs->kref, vhost_zerocopy_done_signal);
+}
+
+void vhost_ubuf_put_and_wait(struct vhost_ubuf_ref *ubufs)
+{
+	kref_put(&ubufs->kref, vhost_zerocopy_done_signal);
+	wait_for_completion(&ubufs->done);
+	kfree(ubufs);
+}
+
+/* Called by the lower device when it frees an skb whose frags are guest
+ * buffers.  May run in any context, so just mark the buffer done and
+ * let the worker tell the guest. */
+void vhost_zerocopy_callback(struct ubuf_info *ubuf, bool zerocopy_success)
+{
+	struct vhost_ubuf_ref *ubufs = ubuf->ctx;
+	struct vhost_virtqueue *vq = ubufs->vq;
+
+	/* set len = 1 to mark this desc buffers done DMA */
+	vq->heads[ubuf->desc].len = VHOST_DMA_DONE_LEN;
+	vhost_poll_queue(&vq->poll);
+	kref_put(&ubufs->kref, vhost_zerocopy_done_signal);
+}
+
+/* The lower device may complete zerocopy buffers out of order.  upend_idx
+ * tracks the end of the outstanding ones and done_idx the first of them:
+ * hand buffers back to the guest in order, stopping at the first one still
+ * in flight.  Caller must have vq mutex and the owner's mm. */
+int vhost_zerocopy_signal_used(struct vhost_virtqueue *vq)
+{
+	int i;
+	int j = 0;
+
+	for (i = vq->done_idx; i != vq->upend_idx; i = (i + 1) % UIO_MAXIOV) {
+		if (vq->heads[i].len != VHOST_DMA_DONE_LEN)
+			break;
+		vq->heads[i].len = VHOST_DMA_CLEAR_LEN;
+		vhost_add_used_and_signal(vq->dev, vq, vq->heads[i].id, 0);
+		++j;
+	}
+	if (j)
+		vq->done_idx = i;
+	return j;
+}
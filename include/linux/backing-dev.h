@@ -40,6 +40,8 @@ typedef int (congested_fn)(void *, int);
 enum bdi_stat_item {
 	BDI_RECLAIMABLE,
 	BDI_WRITEBACK,
+	BDI_READAHEAD_HIT,	/* readahead continuing a tracked stream */
+	BDI_READAHEAD_MISS,	/* readahead starting a new stream */
 	NR_BDI_STAT_ITEMS
 };
 
@@ -26,6 +26,9 @@ struct scsi_ioctl_command;
 
 struct request_queue;
 struct elevator_queue;
+struct blk_mq_ops;
+struct blk_mq_ctx;
+struct blk_mq_hw_ctx;
 struct request_pm_state;
 struct blk_trace;
 struct request;
@@ -81,6 +84,7 @@ struct request {
 	struct call_single_data csd;
 
 	struct request_queue *q;
+	struct blk_mq_ctx *mq_ctx;
 
 	unsigned int cmd_flags;
 	enum rq_cmd_type_bits cmd_type;
@@ -117,6 +121,8 @@ struct request {
 	struct gendisk *rq_disk;
 	struct hd_struct *part;
 	unsigned long start_time;
+	u64 issue_time;			/* ns, when latency is accounted */
+	unsigned char issue_size;	/* blk_lat_hist size bucket */
 #ifdef CONFIG_BLK_CGROUP
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
@@ -191,6 +197,7 @@ typedef int (make_request_fn) (struct request_queue *q, struct bio *bio);
 typedef int (prep_rq_fn) (struct request_queue *, struct request *);
 typedef void (unprep_rq_fn) (struct request_queue *, struct request *);
 typedef void (unplug_fn) (struct request_queue *);
+typedef int (poll_queue_fn) (struct request_queue *);
 
 struct bio_vec;
 struct bvec_merge_data {
@@ -255,6 +262,40 @@ struct queue_limits {
 	signed char		discard_zeroes_data;
 };
 
+/*
+ * Per-cpu completion statistics of a queue that can be polled, see
+ * blk_poll().  Index 0 of nr[] and time[] counts requests completed
+ * from interrupts, index 1 those reaped by polling.
+ */
+struct blk_poll_stat {
+	unsigned long		polls;		/* blk_poll() calls */
+	unsigned long		poll_hits;	/* ... that reaped completions */
+	u64			poll_time;	/* ns spent spinning */
+	unsigned long		nr[2];		/* completed requests */
+	u64			time[2];	/* their issue to completion ns */
+};
+
+/*
+ * Per-cpu completion latency histograms of a queue, indexed by kind of
+ * request, size bucket (up to 4k, 32k, 256k and larger) and latency
+ * bucket.  Latency bucket n > 0 counts requests that took [2^(n-1), 2^n)
+ * usecs from dispatch to completion, the last one everything slower.
+ */
+enum {
+	BLK_LAT_READ		= 0,
+	BLK_LAT_WRITE		= 1,
+	BLK_LAT_SYNC		= 2,	/* synchronous writes */
+	BLK_LAT_DISCARD		= 3,
+	BLK_LAT_OPS		= 4,
+
+	BLK_LAT_SIZES		= 4,
+	BLK_LAT_BUCKETS		= 22,
+};
+
+struct blk_lat_hist {
+	unsigned long		nr[BLK_LAT_OPS][BLK_LAT_SIZES][BLK_LAT_BUCKETS];
+};
+
 struct request_queue
 {
 	/*
@@ -270,6 +311,7 @@ struct request_queue
 	struct request_list	rq;
 
 	request_fn_proc		*request_fn;
+	struct blk_mq_ops	*mq_ops;
 	make_request_fn		*make_request_fn;
 	prep_rq_fn		*prep_rq_fn;
 	unprep_rq_fn		*unprep_rq_fn;
@@ -279,6 +321,7 @@ struct request_queue
 	rq_timed_out_fn		*rq_timed_out_fn;
 	dma_drain_needed_fn	*dma_drain_needed;
 	lld_busy_fn		*lld_busy_fn;
+	poll_queue_fn		*poll_fn;
 
 	/*
 	 * Dispatch queue sorting
@@ -369,6 +412,19 @@ struct request_queue
 	struct request		*orig_flush_rq;
 	struct list_head	pending_flushes;
 
+	/*
+	 * multiqueue devices: per-cpu software queues, the hardware queues
+	 * they are mapped to and the depth of each hardware queue
+	 */
+	unsigned int		*mq_map;
+	struct blk_mq_ctx __percpu *queue_ctx;
+	struct blk_mq_hw_ctx	**queue_hw_ctx;
+	unsigned int		nr_hw_queues;
+	unsigned int		queue_depth;
+
+	struct blk_poll_stat __percpu *poll_stat;
+	struct blk_lat_hist __percpu *lat_hist;
+
 	struct mutex		sysfs_lock;
 
 #if defined(CONFIG_BLK_DEV_BSG)
@@ -401,6 +457,7 @@ struct request_queue
 #define QUEUE_FLAG_NOXMERGES   17	/* No extended merges */
 #define QUEUE_FLAG_ADD_RANDOM  18	/* Contributes to random pool */
 #define QUEUE_FLAG_SECDISCARD  19	/* supports SECDISCARD */
+#define QUEUE_FLAG_POLL        20	/* sync I/O polls for completions */
 
 #define QUEUE_FLAG_DEFAULT	((1 << QUEUE_FLAG_IO_STAT) |		\
 				 (1 << QUEUE_FLAG_STACKABLE)	|	\
@@ -481,6 +538,7 @@ static inline void queue_flag_clear(unsigned int flag, struct request_queue *q)
 #define blk_queue_nonrot(q)	test_bit(QUEUE_FLAG_NONROT, &(q)->queue_flags)
 #define blk_queue_io_stat(q)	test_bit(QUEUE_FLAG_IO_STAT, &(q)->queue_flags)
 #define blk_queue_add_random(q)	test_bit(QUEUE_FLAG_ADD_RANDOM, &(q)->queue_flags)
+#define blk_queue_poll(q)	test_bit(QUEUE_FLAG_POLL, &(q)->queue_flags)
 #define blk_queue_stackable(q)	\
 	test_bit(QUEUE_FLAG_STACKABLE, &(q)->queue_flags)
 #define blk_queue_discard(q)	test_bit(QUEUE_FLAG_DISCARD, &(q)->queue_flags)
@@ -702,6 +760,7 @@ extern void blk_sync_queue(struct request_queue *q);
 extern void __blk_stop_queue(struct request_queue *q);
 extern void __blk_run_queue(struct request_queue *q, bool force_kblockd);
 extern void blk_run_queue(struct request_queue *);
+extern bool blk_poll(struct request_queue *q);
 extern int blk_rq_map_user(struct request_queue *, struct request *,
 			   struct rq_map_data *, void __user *, unsigned long,
 			   gfp_t);
@@ -847,6 +906,7 @@ extern void blk_queue_softirq_done(struct request_queue *, softirq_done_fn *);
 extern void blk_queue_rq_timed_out(struct request_queue *, rq_timed_out_fn *);
 extern void blk_queue_rq_timeout(struct request_queue *, unsigned int);
 extern void blk_queue_flush(struct request_queue *q, unsigned int flush);
+extern int blk_queue_poll_fn(struct request_queue *q, poll_queue_fn *fn);
 extern struct backing_dev_info *blk_get_backing_dev_info(struct block_device *bdev);
 
 extern int blk_rq_map_sg(struct request_queue *, struct request *, struct scatterlist *);
@@ -859,6 +919,49 @@ struct request_queue *blk_alloc_queue(gfp_t);
 struct request_queue *blk_alloc_queue_node(gfp_t, int);
 extern void blk_put_queue(struct request_queue *);
 
+/*
+ * blk_plug allows a task to batch the requests it submits: between
+ * blk_start_plug() and blk_finish_plug(), requests are collected on the
+ * plug on the submitter's stack, where contiguous bios are merged without
+ * taking the queue lock.  They are sorted and handed to the elevator, one
+ * queue lock round trip per queue, when the plug is finished, when too
+ * many of them have been collected, or when the task blocks.
+ */
+struct blk_plug {
+	unsigned long magic;
+	struct list_head list;		/* requests */
+	unsigned int count;		/* number of requests on list */
+	unsigned int should_sort;	/* list is for more than one queue */
+};
+#define BLK_MAX_REQUEST_COUNT	16
+
+extern void blk_start_plug(struct blk_plug *);
+extern void blk_finish_plug(struct blk_plug *);
+extern void blk_flush_plug_list(struct blk_plug *, bool);
+
+static inline void blk_flush_plug(struct task_struct *tsk)
+{
+	struct blk_plug *plug = tsk->plug;
+
+	if (plug)
+		blk_flush_plug_list(plug, false);
+}
+
+static inline void blk_schedule_flush_plug(struct task_struct *tsk)
+{
+	struct blk_plug *plug = tsk->plug;
+
+	if (plug)
+		blk_flush_plug_list(plug, true);
+}
+
+static inline bool blk_needs_flush_plug(struct task_struct *tsk)
+{
+	struct blk_plug *plug = tsk->plug;
+
+	return plug && !list_empty(&plug->list);
+}
+
 /*
  * tag stuff
  */
@@ -1276,6 +1379,30 @@ static inline long nr_blockdev_pages(void)
 	return 0;
 }
 
+struct blk_plug {
+};
+
+static inline void blk_start_plug(struct blk_plug *plug)
+{
+}
+
+static inline void blk_finish_plug(struct blk_plug *plug)
+{
+}
+
+static inline void blk_flush_plug(struct task_struct *task)
+{
+}
+
+static inline void blk_schedule_flush_plug(struct task_struct *task)
+{
+}
+
+static inline bool blk_needs_flush_plug(struct task_struct *tsk)
+{
+	return false;
+}
+
 #endif /* CONFIG_BLOCK */
 
 #endif
@@ -0,0 +1,70 @@
+/*
+ * faultstats.h - page fault latency statistics
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef _LINUX_FAULTSTATS_H
+#define _LINUX_FAULTSTATS_H
+
+#include <linux/types.h>
+
+struct task_struct;
+struct taskstats;
+
+/*
+ * Kinds of faults told apart by handle_mm_fault().  Must match the
+ * fault_stat_names in mm/faultstats.c.
+ */
+enum fault_stat_item {
+	FAULT_ANON,		/* new anonymous page */
+	FAULT_FILE,		/* page cache hit */
+	FAULT_FILE_MAJOR,	/* page read from the backing file */
+	FAULT_SWAPIN,		/* anonymous page read back from swap */
+	FAULT_COW,		/* copy-on-write or write-protect */
+	FAULT_OTHER,		/* hugetlb, accessed/dirty bit updates */
+	NR_FAULT_STAT_ITEMS
+};
+
+/*
+ * Latency histogram buckets, log2 of microseconds: bucket 0 counts
+ * faults under 1us, bucket n those of [2^(n-1), 2^n) us and the last
+ * one everything slower.
+ */
+#define FAULT_STAT_BUCKETS	24
+
+struct task_fault_stats {
+	u64	count[NR_FAULT_STAT_ITEMS];
+	u64	time[NR_FAULT_STAT_ITEMS];	/* nanoseconds */
+};
+
+#ifdef CONFIG_PAGE_FAULT_STATS
+
+/* Caller must include <linux/sched.h> */
+#define fault_stats_clock()	local_clock()
+
+extern void fault_stats_account(unsigned long address,
+				enum fault_stat_item item, int ret, u64 start);
+extern void fault_stats_tsk_init(struct task_struct *tsk);
+extern void fault_stats_add_tsk(struct taskstats *stats,
+				struct task_struct *tsk);
+
+#else
+
+#define fault_stats_clock()	0ULL
+
+static inline void fault_stats_account(unsigned long address,
+				enum fault_stat_item item, int ret, u64 start)
+{}
+static inline void fault_stats_tsk_init(struct task_struct *tsk)
+{}
+static inline void fault_stats_add_tsk(struct taskstats *stats,
+				struct task_struct *tsk)
+{}
+
+#endif /* CONFIG_PAGE_FAULT_STATS */
+
+#endif /* _LINUX_FAULTSTATS_H */
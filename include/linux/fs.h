@@ -639,6 +639,7 @@ struct address_space {
 	spinlock_t		i_mmap_lock;	/* protect tree, count, list */
 	unsigned int		truncate_count;	/* Cover race condition with truncate */
 	unsigned long		nrpages;	/* number of total pages */
+	unsigned long		nrshadows;	/* number of shadow entries */
 	pgoff_t			writeback_index;/* writeback starts here */
 	const struct address_space_operations *a_ops;	/* methods */
 	unsigned long		flags;		/* error bits/gfp mask */
@@ -904,6 +905,21 @@ struct fown_struct {
 /*
  * Track a single file's readahead state
  */
+/*
+ * Number of sequential streams tracked per file besides the current one,
+ * see ra_switch_stream().
+ */
+#define RA_STREAMS	3
+
+/*
+ * Readahead window of a sequential stream that is not the current one.
+ */
+struct file_ra_stream {
+	pgoff_t start;
+	unsigned int size;		/* 0 if the slot is unused */
+	unsigned int async_size;
+};
+
 struct file_ra_state {
 	pgoff_t start;			/* where readahead started */
 	unsigned int size;		/* # of readahead pages */
@@ -913,6 +929,9 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	/* Other streams, most recently used first */
+	struct file_ra_stream streams[RA_STREAMS];
 };
 
 /*
@@ -312,6 +312,14 @@ struct mm_struct {
 #endif
 	/* How many tasks sharing this mm are OOM_DISABLE */
 	atomic_t oom_disable_count;
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+	/*
+	 * Set when reclaim has cleared ptes of this mm without flushing
+	 * the tlb yet.  Anyone changing ptes under the page table lock
+	 * must flush first, see flush_tlb_batched_pending().
+	 */
+	bool tlb_flush_batched;
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
@@ -114,6 +114,9 @@ enum zone_stat_item {
 	NUMA_LOCAL,		/* allocation from local node */
 	NUMA_OTHER,		/* allocation from other node */
 #endif
+	WORKINGSET_REFAULT,	/* evicted page cache faulted back in */
+	WORKINGSET_ACTIVATE,	/* refault activated: was in the workingset */
+	WORKINGSET_NODERECLAIM,	/* shadow-only radix tree node freed */
 	NR_VM_ZONE_STAT_ITEMS };
 
 /*
@@ -362,6 +365,11 @@ struct zone {
 	 */
 	unsigned int inactive_ratio;
 
+	/*
+	 * Evictions and activations of file pages, used as a clock by
+	 * the refault distance calculation in mm/workingset.c.
+	 */
+	atomic_long_t		inactive_age;
 
 	ZONE_PADDING(_pad2_)
 	/* Rarely used or read-mostly fields */
@@ -639,6 +647,12 @@ typedef struct pglist_data {
 	wait_queue_head_t kswapd_wait;
 	struct task_struct *kswapd;
 	int kswapd_max_order;
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	int kcompactd_max_order;
+	int kcompactd_classzone_idx;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
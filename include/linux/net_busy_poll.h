@@ -0,0 +1,29 @@
+/*
+ * Userspace API for per-socket busy poll statistics
+ */
+
+#ifndef _NET_BUSY_POLL_STATS_H
+#define _NET_BUSY_POLL_STATS_H
+
+#include <linux/types.h>
+#include <linux/socket.h>   /* for SO_BUSY_POLL_STATS */
+
+/**
+ * struct so_busy_poll_stats - %SO_BUSY_POLL_STATS getsockopt result
+ *
+ * @rx_packets:	packets the socket's busy polling pulled in from the
+ *		device, for this socket or any other
+ * @success:	busy loops that ended with data queued on the socket
+ * @fail:	busy loops that ended without, before the socket slept
+ *
+ * The counters start at zero when the socket is created and are
+ * updated without locking, so concurrent readers of one socket may
+ * lose an occasional increment.
+ */
+struct so_busy_poll_stats {
+	__u64	rx_packets;
+	__u64	success;
+	__u64	fail;
+};
+
+#endif /* _NET_BUSY_POLL_STATS_H */
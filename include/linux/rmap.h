@@ -195,6 +195,9 @@ enum ttu_flags {
 	TTU_IGNORE_MLOCK = (1 << 8),	/* ignore mlock */
 	TTU_IGNORE_ACCESS = (1 << 9),	/* don't age */
 	TTU_IGNORE_HWPOISON = (1 << 10),/* corrupted page is recoverable */
+	TTU_BATCH_FLUSH = (1 << 11),	/* batch tlb flushes where possible
+					 * and caller guarantees they will
+					 * be done when it is safe */
 };
 #define TTU_ACTION(x) ((x) & TTU_ACTION_MASK)
 
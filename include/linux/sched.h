@@ -88,6 +88,7 @@ struct sched_param {
 #include <linux/timer.h>
 #include <linux/hrtimer.h>
 #include <linux/task_io_accounting.h>
+#include <linux/faultstats.h>
 #include <linux/kobject.h>
 #include <linux/latencytop.h>
 #include <linux/cred.h>
@@ -98,6 +99,7 @@ struct exec_domain;
 struct futex_pi_state;
 struct robust_list_head;
 struct bio_list;
+struct blk_plug;
 struct fs_struct;
 struct perf_event_context;
 
@@ -1179,6 +1181,24 @@ enum perf_event_task_context {
 	perf_nr_task_contexts,
 };
 
+/*
+ * Pages unmapped by reclaim whose tlb flush is deferred, so that a
+ * whole batch of them is flushed with one round of IPIs.
+ */
+struct tlbflush_unmap_batch {
+	/* cpus that may have cached the unmapped translations */
+	struct cpumask cpumask;
+
+	/* true if a flush is needed before the pages are freed */
+	bool flush_required;
+
+	/*
+	 * true if a dirty pte was cleared, so the tlb must be flushed
+	 * before the page is written out
+	 */
+	bool writable;
+};
+
 struct task_struct {
 	volatile long state;	/* -1 unrunnable, 0 runnable, >0 stopped */
 	void *stack;
@@ -1415,14 +1435,25 @@ struct task_struct {
 
 /* VM state */
 	struct reclaim_state *reclaim_state;
+#ifdef CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH
+	struct tlbflush_unmap_batch tlb_ubc;
+#endif
 
 	struct backing_dev_info *backing_dev_info;
 
 	struct io_context *io_context;
 
+#ifdef CONFIG_BLOCK
+	/* stack plugging */
+	struct blk_plug *plug;
+#endif
+
 	unsigned long ptrace_message;
 	siginfo_t *last_siginfo; /* For ptrace use.  */
 	struct task_io_accounting ioac;
+#ifdef CONFIG_PAGE_FAULT_STATS
+	struct task_fault_stats fault_stats;
+#endif
 #if defined(CONFIG_TASK_XACCT)
 	u64 acct_rss_mem1;	/* accumulated rss usage */
 	u64 acct_vm_mem1;	/* accumulated virtual memory usage */
@@ -33,7 +33,7 @@
  */
 
 
-#define TASKSTATS_VERSION	8
+#define TASKSTATS_VERSION	9
 #define TS_COMM_LEN		32	/* should be >= TASK_COMM_LEN
 					 * in linux/sched.h */
 
@@ -163,6 +163,22 @@ struct taskstats {
 	/* Delay waiting for memory reclaim */
 	__u64	freepages_count;
 	__u64	freepages_delay_total;
+
+	/* Version 9 */
+
+	/* Page faults and time spent handling them [nsec], by kind */
+	__u64	anon_fault_count;
+	__u64	anon_fault_delay_total;
+	__u64	file_fault_count;
+	__u64	file_fault_delay_total;
+	__u64	file_major_fault_count;
+	__u64	file_major_fault_delay_total;
+	__u64	swapin_fault_count;
+	__u64	swapin_fault_delay_total;
+	__u64	cow_fault_count;
+	__u64	cow_fault_delay_total;
+	__u64	other_fault_count;
+	__u64	other_fault_delay_total;
 };
 
 
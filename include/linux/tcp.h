@@ -106,12 +106,14 @@ enum {
 #define TCP_THIN_LINEAR_TIMEOUTS 16      /* Use linear timeouts for thin streams*/
 #define TCP_THIN_DUPACK         17      /* Fast retrans. after 1 dupack */
 #define TCP_USER_TIMEOUT	18	/* How long for loss retry before timeout */
+#define TCP_FASTOPEN		23	/* Enable FastOpen on listeners */
 
 /* for TCP_INFO socket option */
 #define TCPI_OPT_TIMESTAMPS	1
 #define TCPI_OPT_SACK		2
 #define TCPI_OPT_WSCALE		4
 #define TCPI_OPT_ECN		8
+#define TCPI_OPT_SYN_DATA	32 /* SYN-ACK acked data in SYN sent or rcvd */
 
 enum tcp_ca_state {
 	TCP_CA_Open = 0,
@@ -273,6 +275,7 @@ static inline void tcp_clear_options(struct tcp_options_received *rx_opt)
 
 struct tcp_cookie_values;
 struct tcp_request_sock_ops;
+struct tcp_fastopen_request;
 
 struct tcp_request_sock {
 	struct inet_request_sock 	req;
@@ -460,6 +463,31 @@ struct tcp_sock {
 	 * contains related tcp_cookie_transactions fields.
 	 */
 	struct tcp_cookie_values  *cookie_values;
+
+/* TCP Fast Open */
+	u8	syn_data:1,	/* SYN includes data */
+		syn_fastopen:1,	/* SYN includes Fast Open option */
+		syn_data_acked:1;/* data in SYN is acked by SYN-ACK */
+	u16	fastopen_qlen;	/* listener: max pending fast open children */
+	/* Client: the data and cookie to send in the SYN, only valid
+	 * between the sendto(MSG_FASTOPEN) and the SYN going out.
+	 */
+	struct tcp_fastopen_request *fastopen_req;
+	/* Server: the request sock of a fast open child still in
+	 * SYN_RECV; the child retransmits the SYN-ACK on its behalf
+	 * until the handshake completes.
+	 */
+	struct request_sock *fastopen_rsk;
+
+	/* TCP Small Queues: see tcp_wfree() */
+	unsigned long	tsq_flags;
+	struct list_head tsq_node; /* anchor in tsq_tasklet.head list */
+};
+
+enum tsq_flags {
+	TSQ_THROTTLED,		/* tcp_write_xmit() stopped on the output limit */
+	TSQ_QUEUED,		/* socket is on the tsq_tasklet list */
+	TCP_TSQ_DEFERRED,	/* tasklet found the socket owned by user */
 };
 
 static inline struct tcp_sock *tcp_sk(const struct sock *sk)
@@ -13,6 +13,15 @@
 #include <linux/spinlock.h>
 #include <asm/atomic.h>
 
+/* TCP Fast Open client cache, see tcp_fastopen.c */
+struct inet_peer_fastopen {
+	__u16			mss;		/* peer's MSS */
+	__u8			syn_loss;	/* SYN data losses */
+	__s8			cookie_len;	/* -1: none */
+	__u8			cookie[16];
+	unsigned long		last_syn_loss;	/* jiffies */
+};
+
 struct inet_peer {
 	/* group together avl_left,avl_right,v4daddr to speedup lookups */
 	struct inet_peer __rcu	*avl_left, *avl_right;
@@ -24,9 +33,11 @@ struct inet_peer {
 	atomic_t		refcnt;
 	/*
 	 * Once inet_peer is queued for deletion (refcnt == -1), following fields
-	 * are not available: rid, ip_id_count, tcp_ts, tcp_ts_stamp
+	 * are not available: rid, ip_id_count, tcp_ts, tcp_ts_stamp,
+	 * tcp_fastopen
 	 * We can share memory with rcu_head to keep inet_peer small
-	 * (less then 64 bytes)
+	 * (less then 64 bytes).  tcp_fastopen is allocated only for peers
+	 * that use Fast Open, and is freed before rcu is reused.
 	 */
 	union {
 		struct {
@@ -34,6 +45,7 @@ struct inet_peer {
 			atomic_t	ip_id_count;	/* IP ID for the next packet */
 			__u32		tcp_ts;
 			__u32		tcp_ts_stamp;
+			struct inet_peer_fastopen *tcp_fastopen;
 		};
 		struct rcu_head         rcu;
 	};
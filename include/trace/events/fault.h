@@ -0,0 +1,50 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM fault
+
+#if !defined(_TRACE_FAULT_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_FAULT_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+#include <linux/faultstats.h>
+
+#define show_fault_item(item)					\
+	__print_symbolic(item,					\
+		{ FAULT_ANON,		"anon" },		\
+		{ FAULT_FILE,		"file" },		\
+		{ FAULT_FILE_MAJOR,	"file_major" },		\
+		{ FAULT_SWAPIN,		"swapin" },		\
+		{ FAULT_COW,		"cow" },		\
+		{ FAULT_OTHER,		"other" })
+
+TRACE_EVENT(mm_page_fault,
+
+	TP_PROTO(unsigned long address, int item, int ret, u64 latency),
+
+	TP_ARGS(address, item, ret, latency),
+
+	TP_STRUCT__entry(
+		__field(	unsigned long,	address	)
+		__field(	int,		item	)
+		__field(	int,		ret	)
+		__field(	u64,		latency	)
+	),
+
+	TP_fast_assign(
+		__entry->address	= address;
+		__entry->item		= item;
+		__entry->ret		= ret;
+		__entry->latency	= latency;
+	),
+
+	TP_printk("address=0x%lx type=%s ret=0x%x latency=%llu ns",
+		__entry->address,
+		show_fault_item(__entry->item),
+		__entry->ret,
+		(unsigned long long)__entry->latency)
+);
+
+#endif /* _TRACE_FAULT_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
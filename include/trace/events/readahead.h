@@ -0,0 +1,82 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM readahead
+
+#if !defined(_TRACE_READAHEAD_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_READAHEAD_H
+
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/tracepoint.h>
+
+#ifndef _TRACE_READAHEAD_PATTERN
+#define _TRACE_READAHEAD_PATTERN
+/*
+ * How ondemand_readahead() classified a read
+ */
+enum readahead_pattern {
+	RA_PATTERN_INITIAL,	/* start of file or sequential cache miss */
+	RA_PATTERN_SEQUENTIAL,	/* continues the current stream */
+	RA_PATTERN_STREAM,	/* continues another tracked stream */
+	RA_PATTERN_MARKER,	/* hit a marker of an untracked stream */
+	RA_PATTERN_CONTEXT,	/* stream found in the page cache */
+	RA_PATTERN_OVERSIZE,	/* read larger than the readahead window */
+	RA_PATTERN_RANDOM,	/* small random read, no readahead */
+};
+#endif
+
+#define show_readahead_pattern(pattern)				\
+	__print_symbolic(pattern,					\
+		{ RA_PATTERN_INITIAL,		"initial" },		\
+		{ RA_PATTERN_SEQUENTIAL,	"sequential" },		\
+		{ RA_PATTERN_STREAM,		"stream" },		\
+		{ RA_PATTERN_MARKER,		"marker" },		\
+		{ RA_PATTERN_CONTEXT,		"context" },		\
+		{ RA_PATTERN_OVERSIZE,		"oversize" },		\
+		{ RA_PATTERN_RANDOM,		"random" })
+
+TRACE_EVENT(readahead,
+
+	TP_PROTO(struct address_space *mapping, pgoff_t offset,
+		 unsigned long req_size, struct file_ra_state *ra,
+		 int pattern, int actual),
+
+	TP_ARGS(mapping, offset, req_size, ra, pattern, actual),
+
+	TP_STRUCT__entry(
+		__field(	dev_t,		dev		)
+		__field(	ino_t,		ino		)
+		__field(	pgoff_t,	offset		)
+		__field(	unsigned long,	req_size	)
+		__field(	pgoff_t,	start		)
+		__field(	unsigned int,	size		)
+		__field(	unsigned int,	async_size	)
+		__field(	int,		pattern		)
+		__field(	int,		actual		)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= mapping->host->i_sb->s_dev;
+		__entry->ino		= mapping->host->i_ino;
+		__entry->offset		= offset;
+		__entry->req_size	= req_size;
+		__entry->start		= ra->start;
+		__entry->size		= ra->size;
+		__entry->async_size	= ra->async_size;
+		__entry->pattern	= pattern;
+		__entry->actual		= actual;
+	),
+
+	TP_printk("dev=%d,%d ino=%lu pattern=%s offset=%lu req_size=%lu "
+		  "start=%lu size=%u async_size=%u actual=%d",
+		MAJOR(__entry->dev), MINOR(__entry->dev),
+		(unsigned long)__entry->ino,
+		show_readahead_pattern(__entry->pattern),
+		(unsigned long)__entry->offset, __entry->req_size,
+		(unsigned long)__entry->start, __entry->size,
+		__entry->async_size, __entry->actual)
+);
+
+#endif /* _TRACE_READAHEAD_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -195,6 +195,8 @@ static void fill_stats(struct task_struct *tsk, struct taskstats *stats)
 
 	/* fill in extended acct fields */
 	xacct_add_tsk(stats, tsk);
+
+	fault_stats_add_tsk(stats, tsk);
 }
 
 static int fill_stats_for_pid(pid_t pid, struct taskstats *stats)
@@ -245,6 +247,7 @@ static int fill_stats_for_tgid(pid_t tgid, struct taskstats *stats)
 		 *	per-task-foo(stats, tsk);
 		 */
 		delayacct_add_tsk(stats, tsk);
+		fault_stats_add_tsk(stats, tsk);
 
 		stats->nvcsw += tsk->nvcsw;
 		stats->nivcsw += tsk->nivcsw;
@@ -278,6 +281,7 @@ static void fill_tgid_exit(struct task_struct *tsk)
 	 *	per-task-foo(tsk->signal->stats, tsk);
 	 */
 	delayacct_add_tsk(tsk->signal->stats, tsk);
+	fault_stats_add_tsk(tsk->signal->stats, tsk);
 ret:
 	spin_unlock_irqrestore(&tsk->sighand->siglock, flags);
 	return;
@@ -0,0 +1,537 @@
+/*
+ * Socket filter JIT regression test module
+ *
+ * Runs a set of filters over a set of packets, both through the
+ * interpreter and through the code generated by the BPF JIT, and
+ * complains about every packet where the two disagree.  Also prints
+ * how long each takes per packet.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2
+ * of the License.
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+#include <linux/ktime.h>
+#include <net/net_namespace.h>
+
+static int runs = 1000;
+module_param(runs, int, S_IRUGO);
+MODULE_PARM_DESC(runs, "Iterations of each filter when timing it");
+
+/*
+ * Packets, starting with the ethernet header
+ */
+static const u8 pkt_tcp[] = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb,
+	0x08, 0x00,
+	/* IPv4, ihl 5, tcp, 10.0.0.1 -> 10.0.0.2 */
+	0x45, 0x00, 0x00, 0x30, 0x12, 0x34, 0x40, 0x00, 0x40, 0x06, 0x00, 0x00,
+	0x0a, 0x00, 0x00, 0x01, 0x0a, 0x00, 0x00, 0x02,
+	/* 40000 -> 22 */
+	0x9c, 0x40, 0x00, 0x16, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x50, 0x02, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0xde, 0xad, 0xbe, 0xef, 0x01, 0x02, 0x03, 0x04,
+};
+
+static const u8 pkt_udp[] = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb,
+	0x08, 0x00,
+	/* IPv4, ihl 6, udp, 192.168.1.1 -> 10.0.0.2 */
+	0x46, 0x00, 0x00, 0x2c, 0x00, 0x01, 0x00, 0x00, 0x40, 0x11, 0x00, 0x00,
+	0xc0, 0xa8, 0x01, 0x01, 0x0a, 0x00, 0x00, 0x02, 0x01, 0x01, 0x00, 0x00,
+	/* 1053 -> 53 */
+	0x04, 0x1d, 0x00, 0x35, 0x00, 0x10, 0x00, 0x00,
+	0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00,
+};
+
+static const u8 pkt_frag[] = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb,
+	0x08, 0x00,
+	/* IPv4 fragment at offset 8, tcp */
+	0x45, 0x00, 0x00, 0x1c, 0x12, 0x35, 0x00, 0x01, 0x40, 0x06, 0x00, 0x00,
+	0x0a, 0x00, 0x00, 0x01, 0x0a, 0x00, 0x00, 0x02,
+	0x00, 0x16, 0x00, 0x16, 0x00, 0x00, 0x00, 0x00,
+};
+
+static const u8 pkt_arp[] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb,
+	0x08, 0x06,
+	0x00, 0x01, 0x08, 0x00, 0x06, 0x04, 0x00, 0x01,
+	0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0x0a, 0x00, 0x00, 0x01,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x02,
+};
+
+static const u8 pkt_short[] = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66,
+};
+
+struct bpf_test_pkt {
+	const char		*descr;
+	const u8		*data;
+	unsigned int		len;
+	__be16			protocol;
+};
+
+#define PKT(p, proto)	{ #p, p, sizeof(p), htons(proto) }
+
+static const struct bpf_test_pkt test_pkts[] = {
+	PKT(pkt_tcp, ETH_P_IP),
+	PKT(pkt_udp, ETH_P_IP),
+	PKT(pkt_frag, ETH_P_IP),
+	PKT(pkt_arp, ETH_P_ARP),
+	PKT(pkt_short, 0),
+};
+
+/*
+ * Filters.  Most of them return something computed from the packet
+ * instead of just accept or drop, so that more differences show.
+ */
+static struct sock_filter ret_k[] = {
+	BPF_STMT(BPF_RET | BPF_K, 0xffff),
+};
+
+static struct sock_filter ret_a[] = {
+	BPF_STMT(BPF_RET | BPF_A, 0),
+};
+
+/* tcpdump -dd ip */
+static struct sock_filter tcpdump_ip[] = {
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x800, 0, 1),
+	BPF_STMT(BPF_RET | BPF_K, 0xffff),
+	BPF_STMT(BPF_RET | BPF_K, 0),
+};
+
+/* tcpdump -dd tcp port 22, IPv4 part */
+static struct sock_filter tcpdump_tcp_22[] = {
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x800, 0, 10),
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 6, 0, 8),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 20),
+	BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 6, 0),
+	BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+	BPF_STMT(BPF_LD | BPF_H | BPF_IND, 14),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 22, 2, 0),
+	BPF_STMT(BPF_LD | BPF_H | BPF_IND, 16),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 22, 0, 1),
+	BPF_STMT(BPF_RET | BPF_K, 0xffff),
+	BPF_STMT(BPF_RET | BPF_K, 0),
+};
+
+/* udp dst port 53, returns the udp payload offset */
+static struct sock_filter udp_53[] = {
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 17, 0, 6),
+	BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+	BPF_STMT(BPF_LD | BPF_H | BPF_IND, 16),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 53, 0, 3),
+	BPF_STMT(BPF_MISC | BPF_TXA, 0),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 14 + 8),
+	BPF_STMT(BPF_RET | BPF_A, 0),
+	BPF_STMT(BPF_RET | BPF_K, 0),
+};
+
+static struct sock_filter alu_k[] = {
+	BPF_STMT(BPF_LD | BPF_IMM, 5),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 3),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 0x12345),
+	BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 7),
+	BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 0x10001),
+	BPF_STMT(BPF_ALU | BPF_SUB | BPF_K, 1),
+	BPF_STMT(BPF_ALU | BPF_SUB | BPF_K, 0x1000),
+	BPF_STMT(BPF_ALU | BPF_DIV | BPF_K, 3),
+	BPF_STMT(BPF_ALU | BPF_OR | BPF_K, 0x100),
+	BPF_STMT(BPF_ALU | BPF_OR | BPF_K, 0x70000000),
+	BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 1),
+	BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 2),
+	BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 1),
+	BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 3),
+	BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xffffff0f),
+	BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xffff0fff),
+	BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x0ffffff0),
+	BPF_STMT(BPF_ALU | BPF_NEG, 0),
+	BPF_STMT(BPF_ALU | BPF_DIV | BPF_K, 0x10000),
+	BPF_STMT(BPF_RET | BPF_A, 0),
+};
+
+static struct sock_filter alu_x[] = {
+	BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+	BPF_STMT(BPF_LDX | BPF_IMM, 3),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_ALU | BPF_MUL | BPF_X, 0),
+	BPF_STMT(BPF_ALU | BPF_SUB | BPF_X, 0),
+	BPF_STMT(BPF_ALU | BPF_LSH | BPF_X, 0),
+	BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0),
+	BPF_STMT(BPF_ALU | BPF_RSH | BPF_X, 0),
+	BPF_STMT(BPF_ALU | BPF_DIV | BPF_X, 0),
+	BPF_STMT(BPF_LDX | BPF_W | BPF_LEN, 0),
+	BPF_STMT(BPF_ALU | BPF_AND | BPF_X, 0),
+	BPF_STMT(BPF_RET | BPF_A, 0),
+};
+
+static struct sock_filter div_x_zero[] = {
+	BPF_STMT(BPF_LD | BPF_IMM, 10),
+	BPF_STMT(BPF_LDX | BPF_IMM, 0),
+	BPF_STMT(BPF_ALU | BPF_DIV | BPF_X, 0),
+	BPF_STMT(BPF_RET | BPF_K, 1),
+};
+
+/* stored words read back, unwritten words read as zero */
+static struct sock_filter scratch_mem[] = {
+	BPF_STMT(BPF_LD | BPF_MEM, 3),
+	BPF_STMT(BPF_LDX | BPF_MEM, 15),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 1),
+	BPF_STMT(BPF_ST, 0),
+	BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+	BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	BPF_STMT(BPF_STX, 15),
+	BPF_STMT(BPF_LD | BPF_MEM, 0),
+	BPF_STMT(BPF_LDX | BPF_MEM, 15),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_RET | BPF_A, 0),
+};
+
+static struct sock_filter ancillary[] = {
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_AD_OFF + SKF_AD_PROTOCOL),
+	BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_MARK),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_AD_OFF + SKF_AD_QUEUE),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_RET | BPF_A, 0),
+};
+
+/* returns 0 when skb->dev is not set */
+static struct sock_filter ancillary_dev[] = {
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_IFINDEX),
+	BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_AD_OFF + SKF_AD_HATYPE),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_RET | BPF_A, 0),
+};
+
+/* unknown ancillary offsets, and indirect loads into that area, fail */
+static struct sock_filter ancillary_bad[] = {
+	BPF_STMT(BPF_LDX | BPF_IMM, SKF_AD_OFF + SKF_AD_MARK),
+	BPF_STMT(BPF_LD | BPF_W | BPF_IND, 0),
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_MAX),
+	BPF_STMT(BPF_RET | BPF_K, 1),
+};
+
+static struct sock_filter neg_offsets[] = {
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_NET_OFF + 9),
+	BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_NET_OFF + 2),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_LL_OFF + 8),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, SKF_NET_OFF),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_RET | BPF_A, 0),
+};
+
+/* loads straddling the end of the linear area and of the packet */
+static struct sock_filter loads[] = {
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 18),
+	BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 19),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 20),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_ST, 1),
+	BPF_STMT(BPF_LD | BPF_IMM, 0x1234),
+	BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 30),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_LDX | BPF_MEM, 1),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0),
+	BPF_STMT(BPF_LDX | BPF_IMM, 20),
+	BPF_STMT(BPF_LD | BPF_W | BPF_IND, 4),
+	BPF_STMT(BPF_RET | BPF_A, 0),
+};
+
+static struct sock_filter loads_ind[] = {
+	BPF_STMT(BPF_LDX | BPF_W | BPF_LEN, 0),
+	BPF_STMT(BPF_LD | BPF_B | BPF_IND, -1),
+	BPF_STMT(BPF_MISC | BPF_TAX, 0),
+	BPF_STMT(BPF_LD | BPF_W | BPF_IND, 8),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+	BPF_STMT(BPF_LDX | BPF_W | BPF_LEN, 0),
+	BPF_STMT(BPF_LD | BPF_W | BPF_IND, -4),
+	BPF_STMT(BPF_RET | BPF_A, 0),
+};
+
+static struct sock_filter jumps_k[] = {
+	BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+	BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, 40, 0, 1),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 0x100),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0x140, 1, 0),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 0x1000),
+	BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x8, 0, 1),
+	BPF_STMT(BPF_ALU | BPF_OR | BPF_K, 0x10000),
+	BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1000, 1, 0),
+	BPF_STMT(BPF_ALU | BPF_OR | BPF_K, 0x20000),
+	BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1001, 0, 1),
+	BPF_STMT(BPF_ALU | BPF_OR | BPF_K, 0x40000),
+	BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x10000, 0, 1),
+	BPF_STMT(BPF_ALU | BPF_OR | BPF_K, 0x80000),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x12345678, 0, 1),
+	BPF_STMT(BPF_RET | BPF_K, 7),
+	BPF_JUMP(BPF_JMP | BPF_JA, 1, 0, 0),
+	BPF_STMT(BPF_RET | BPF_K, 8),
+	BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, 0, 0, 0),
+	BPF_STMT(BPF_RET | BPF_A, 0),
+};
+
+static struct sock_filter jumps_x[] = {
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 14),
+	BPF_STMT(BPF_LDX | BPF_W | BPF_LEN, 0),
+	BPF_JUMP(BPF_JMP | BPF_JGT | BPF_X, 0, 0, 1),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 1),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_X, 0, 1, 0),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 2),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_X, 0, 0, 1),
+	BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 4),
+	BPF_JUMP(BPF_JMP | BPF_JSET | BPF_X, 0, 1, 0),
+	BPF_STMT(BPF_RET | BPF_K, 9),
+	BPF_STMT(BPF_RET | BPF_A, 0),
+};
+
+/* filled in by build_long_jump(), needs far jumps */
+#define LONG_JUMP_LEN	100
+static struct sock_filter long_jump[LONG_JUMP_LEN];
+
+struct bpf_test {
+	const char		*descr;
+	struct sock_filter	*insns;
+	unsigned int		len;
+};
+
+#define TEST(f)	{ #f, f, ARRAY_SIZE(f) }
+
+static const struct bpf_test tests[] = {
+	TEST(ret_k),
+	TEST(ret_a),
+	TEST(tcpdump_ip),
+	TEST(tcpdump_tcp_22),
+	TEST(udp_53),
+	TEST(alu_k),
+	TEST(alu_x),
+	TEST(div_x_zero),
+	TEST(scratch_mem),
+	TEST(ancillary),
+	TEST(ancillary_dev),
+	TEST(ancillary_bad),
+	TEST(neg_offsets),
+	TEST(loads),
+	TEST(loads_ind),
+	TEST(jumps_k),
+	TEST(jumps_x),
+	TEST(long_jump),
+};
+
+static void build_long_jump(void)
+{
+	struct sock_filter *f = long_jump;
+	int i;
+
+	f[0] = (struct sock_filter)
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12);
+	f[1] = (struct sock_filter)
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0,
+			 LONG_JUMP_LEN - 3);
+	for (i = 2; i < LONG_JUMP_LEN - 2; i++)
+		f[i] = (struct sock_filter)
+			BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 0x10000 + i);
+	f[i++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_A, 0);
+	f[i] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, 0xffff);
+}
+
+/*
+ * Every packet twice: linear without a device, and with only its first
+ * 20 bytes in the linear area on the loopback device.
+ */
+#define NR_SKBS		(2 * ARRAY_SIZE(test_pkts))
+#define NONLINEAR_HLEN	20
+
+static struct sk_buff *build_skb(const struct bpf_test_pkt *pkt,
+				 bool nonlinear)
+{
+	unsigned int hlen = pkt->len;
+	struct sk_buff *skb;
+
+	if (nonlinear && hlen > NONLINEAR_HLEN)
+		hlen = NONLINEAR_HLEN;
+
+	skb = alloc_skb(hlen, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+	memcpy(skb_put(skb, hlen), pkt->data, hlen);
+
+	if (hlen < pkt->len) {
+		struct page *page = alloc_page(GFP_KERNEL);
+
+		if (!page) {
+			kfree_skb(skb);
+			return NULL;
+		}
+		memcpy(page_address(page), pkt->data + hlen, pkt->len - hlen);
+		skb_fill_page_desc(skb, 0, page, 0, pkt->len - hlen);
+		skb->len += pkt->len - hlen;
+		skb->data_len = pkt->len - hlen;
+		skb->truesize += PAGE_SIZE;
+	}
+
+	skb_reset_mac_header(skb);
+	skb_set_network_header(skb, min_t(unsigned int, ETH_HLEN, hlen));
+	skb->protocol = pkt->protocol;
+	if (nonlinear) {
+		skb->dev = init_net.loopback_dev;
+		skb->pkt_type = PACKET_OTHERHOST;
+		skb->mark = 0x12345678;
+		skb_set_queue_mapping(skb, 3);
+	}
+	return skb;
+}
+
+static u64 time_filter(struct sk_filter *fp, struct sk_buff *skb, bool jit)
+{
+	ktime_t start;
+	int i;
+
+	start = ktime_get();
+	for (i = 0; i < runs; i++) {
+		if (jit)
+			fp->bpf_func(skb, fp->insns);
+		else
+			sk_run_filter(skb, fp->insns, fp->len);
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start)) / runs;
+}
+
+static int run_test(const struct bpf_test *t, struct sk_buff **skbs)
+{
+	struct sk_filter *fp;
+	unsigned int interp, jit;
+	int i, err = 0;
+
+	fp = kmalloc(sizeof(*fp) + t->len * sizeof(struct sock_filter),
+		     GFP_KERNEL);
+	if (!fp)
+		return -ENOMEM;
+
+	atomic_set(&fp->refcnt, 1);
+	fp->len = t->len;
+	fp->bpf_func = NULL;
+	memcpy(fp->insns, t->insns, t->len * sizeof(struct sock_filter));
+
+	if (sk_chk_filter(fp->insns, fp->len)) {
+		printk(KERN_ERR "test_bpf: %s: rejected by sk_chk_filter\n",
+		       t->descr);
+		err = -EINVAL;
+		goto out;
+	}
+
+	bpf_jit_compile(fp);
+	if (!fp->bpf_func) {
+		printk(KERN_ERR "test_bpf: %s: not compiled\n", t->descr);
+		err = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < NR_SKBS; i++) {
+		interp = sk_run_filter(skbs[i], fp->insns, fp->len);
+		jit = fp->bpf_func(skbs[i], fp->insns);
+		if (interp != jit) {
+			printk(KERN_ERR "test_bpf: %s: %s%s: "
+			       "interpreter %u, jit %u\n",
+			       t->descr, test_pkts[i / 2].descr,
+			       i & 1 ? " (nonlinear)" : "", interp, jit);
+			err = -EINVAL;
+		}
+	}
+
+	if (!err && runs > 0)
+		printk(KERN_INFO "test_bpf: %s: %u insns, "
+		       "interpreter %llu ns, jit %llu ns\n",
+		       t->descr, t->len,
+		       time_filter(fp, skbs[0], false),
+		       time_filter(fp, skbs[0], true));
+
+	bpf_jit_free(fp);
+out:
+	kfree(fp);
+	return err;
+}
+
+static int __init test_bpf_init(void)
+{
+	struct sk_buff *skbs[NR_SKBS];
+	int saved_enable = bpf_jit_enable;
+	int i, failed = 0;
+
+	build_long_jump();
+
+	memset(skbs, 0, sizeof(skbs));
+	for (i = 0; i < NR_SKBS; i++) {
+		skbs[i] = build_skb(&test_pkts[i / 2], i & 1);
+		if (!skbs[i]) {
+			failed = -ENOMEM;
+			goto out;
+		}
+	}
+
+	/* compile whatever the sysctl says, but keep its dump setting */
+	if (!bpf_jit_enable)
+		bpf_jit_enable = 1;
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		if (run_test(&tests[i], skbs))
+			failed++;
+	}
+
+	bpf_jit_enable = saved_enable;
+
+	if (failed)
+		printk(KERN_ERR "test_bpf: %d of %zu tests FAILED\n",
+		       failed, ARRAY_SIZE(tests));
+	else
+		printk(KERN_INFO "test_bpf: all %zu tests passed\n",
+		       ARRAY_SIZE(tests));
+out:
+	for (i = 0; i < NR_SKBS; i++)
+		kfree_skb(skbs[i]);
+
+	if (failed < 0)
+		return failed;
+	return failed ? -EINVAL : 0;
+}
+
+static void __exit test_bpf_exit(void)
+{
+}
+
+module_init(test_bpf_init);
+module_exit(test_bpf_exit);
+
+MODULE_DESCRIPTION("Socket filter JIT regression test");
+MODULE_LICENSE("GPL");
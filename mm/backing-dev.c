@@ -96,12 +96,16 @@ static int bdi_debug_stats_show(struct seq_file *m, void *v)
 		   "b_io:             %8lu\n"
 		   "b_more_io:        %8lu\n"
 		   "bdi_list:         %8u\n"
-		   "state:            %8lx\n",
+		   "state:            %8lx\n"
+		   "readahead_hit:    %8lu\n"
+		   "readahead_miss:   %8lu\n",
 		   (unsigned long) K(bdi_stat(bdi, BDI_WRITEBACK)),
 		   (unsigned long) K(bdi_stat(bdi, BDI_RECLAIMABLE)),
 		   K(bdi_thresh), K(dirty_thresh),
 		   K(background_thresh), nr_dirty, nr_io, nr_more_io,
-		   !list_empty(&bdi->bdi_list), bdi->state);
+		   !list_empty(&bdi->bdi_list), bdi->state,
+		   (unsigned long) bdi_stat(bdi, BDI_READAHEAD_HIT),
+		   (unsigned long) bdi_stat(bdi, BDI_READAHEAD_MISS));
 #undef K
 
 	return 0;
@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 /*
@@ -37,6 +39,7 @@ struct compact_control {
 
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
+	bool kcompactd;			/* background compaction */
 	struct zone *zone;
 };
 
@@ -360,6 +363,10 @@ static int compact_finished(struct zone *zone,
 	if (cc->order == -1)
 		return COMPACT_CONTINUE;
 
+	/* kcompactd: the zone meets its watermark at the order again */
+	if (cc->kcompactd)
+		return COMPACT_PARTIAL;
+
 	/* Direct compactor: Is a suitable page free? */
 	for (order = cc->order; order < MAX_ORDER; order++) {
 		/* Job done if page is free of the right migratetype */
@@ -550,6 +557,188 @@ static int compact_node(int nid)
 	return 0;
 }
 
+/*
+ * Background compaction by kcompactd
+ *
+ * When a high-order allocation enters the slow path, the allocator wakes
+ * kcompactd on the nodes of the zones it tried.  If the allocation failed
+ * because of fragmentation rather than low memory, as told by
+ * fragmentation_index() and extfrag_threshold, kcompactd compacts those
+ * zones until the order is available again, so that later allocations do
+ * not stall in direct compaction.  After each run it ignores wakeups for
+ * compact_daemon_millisecs, and zones that it failed to compact are
+ * deferred like they are for direct compaction.
+ */
+int sysctl_compact_daemon_millisecs = 500;
+
+static bool kcompactd_zone_suitable(struct zone *zone, int order)
+{
+	unsigned long watermark;
+	int fragindex;
+
+	if (!populated_zone(zone))
+		return false;
+
+	/* Nothing to do if the order is available */
+	watermark = low_wmark_pages(zone) + (1 << order);
+	if (zone_watermark_ok(zone, order, watermark, 0, 0))
+		return false;
+
+	/* Migration needs free pages to copy to, see try_to_compact_pages() */
+	watermark = low_wmark_pages(zone) + (2UL << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return false;
+
+	/* Leave low memory to kswapd, only act on fragmentation */
+	fragindex = fragmentation_index(zone, order);
+	return fragindex > sysctl_extfrag_threshold;
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int order = pgdat->kcompactd_max_order;
+	int classzone_idx = pgdat->kcompactd_classzone_idx;
+	int zoneid;
+
+	pgdat->kcompactd_max_order = 0;
+	pgdat->kcompactd_classzone_idx = 0;
+
+	for (zoneid = 0; zoneid <= classzone_idx; zoneid++) {
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.kcompactd = true,
+		};
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!kcompactd_zone_suitable(zone, order))
+			continue;
+		if (compaction_deferred(zone))
+			continue;
+
+		cc.zone = zone;
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		compact_zone(zone, &cc);
+
+		/* Page migration frees to the PCP lists but we want merging */
+		preempt_disable();
+		drain_local_pages(NULL);
+		preempt_enable();
+
+		if (zone_watermark_ok(zone, order,
+				      low_wmark_pages(zone) + (1 << order), 0, 0)) {
+			zone->compact_considered = 0;
+			zone->compact_defer_shift = 0;
+			count_vm_event(KCOMPACTD_SUCCESS);
+		} else {
+			defer_compaction(zone);
+			count_vm_event(KCOMPACTD_FAIL);
+		}
+
+		if (kthread_should_stop())
+			return;
+	}
+}
+
+static bool kcompactd_work_requested(pg_data_t *pgdat)
+{
+	return kthread_should_stop() || pgdat->kcompactd_max_order;
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pgdat->kcompactd_wait,
+				     kcompactd_work_requested(pgdat));
+		if (kthread_should_stop())
+			break;
+
+		kcompactd_do_work(pgdat);
+
+		/* Rate limit: wakeups are ignored until we wait again */
+		schedule_timeout_interruptible(
+			msecs_to_jiffies(sysctl_compact_daemon_millisecs));
+	}
+
+	return 0;
+}
+
+/**
+ * wakeup_kcompactd - ask for background compaction of a zone
+ * @zone: zone a high-order allocation could not be satisfied from
+ * @order: order of the allocation
+ * @classzone_idx: highest zone index the allocation may use
+ */
+void wakeup_kcompactd(struct zone *zone, int order, int classzone_idx)
+{
+	pg_data_t *pgdat = zone->zone_pgdat;
+
+	if (!order)
+		return;
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+	if (!kcompactd_zone_suitable(zone, order))
+		return;
+
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	if (pgdat->kcompactd_classzone_idx < classzone_idx)
+		pgdat->kcompactd_classzone_idx = classzone_idx;
+
+	count_vm_event(KCOMPACTD_WAKE);
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		pgdat->kcompactd = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Called by memory hotplug when all memory in a node is offlined.
+ */
+void kcompactd_stop(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init)
+
 /* Compact all nodes in the system */
 static int compact_nodes(void)
 {
@@ -0,0 +1,157 @@
+/*
+ *  linux/mm/faultstats.c
+ *
+ *  Per-cpu page fault latency histograms and per-task fault times.
+ *
+ *  Every fault handled by handle_mm_fault() is timed and accounted by
+ *  kind in the histograms of the current cpu, which are summed up when
+ *  /proc/faultstats is read, and in the task, whose totals are reported
+ *  through taskstats.  The mm_page_fault tracepoint reports each fault.
+ */
+#include <linux/mm.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/taskstats.h>
+#include <linux/faultstats.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/fault.h>
+
+struct fault_stats {
+	unsigned long	count[NR_FAULT_STAT_ITEMS];
+	u64		time[NR_FAULT_STAT_ITEMS];
+	unsigned long	hist[NR_FAULT_STAT_ITEMS][FAULT_STAT_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct fault_stats, fault_stats);
+
+static const char * const fault_stat_names[NR_FAULT_STAT_ITEMS] = {
+	"anon",
+	"file",
+	"file_major",
+	"swapin",
+	"cow",
+	"other",
+};
+
+static inline int fault_stat_bucket(u64 delta)
+{
+	/* 1024ns is close enough to a microsecond */
+	int bucket = fls64(delta >> 10);
+
+	return min(bucket, FAULT_STAT_BUCKETS - 1);
+}
+
+/**
+ * fault_stats_account - account a page fault
+ * @address: faulting address
+ * @item: kind of fault
+ * @ret: VM_FAULT_xxx result of the fault
+ * @start: fault_stats_clock() when the fault was entered
+ */
+void fault_stats_account(unsigned long address, enum fault_stat_item item,
+			 int ret, u64 start)
+{
+	s64 delta = local_clock() - start;
+
+	/* The task may have migrated to a cpu whose clock lags behind */
+	if (delta < 0)
+		delta = 0;
+
+	if (item == FAULT_FILE && (ret & VM_FAULT_MAJOR))
+		item = FAULT_FILE_MAJOR;
+
+	this_cpu_inc(fault_stats.count[item]);
+	this_cpu_add(fault_stats.time[item], delta);
+	this_cpu_inc(fault_stats.hist[item][fault_stat_bucket(delta)]);
+
+	current->fault_stats.count[item]++;
+	current->fault_stats.time[item] += delta;
+
+	trace_mm_page_fault(address, item, ret, delta);
+}
+
+void fault_stats_tsk_init(struct task_struct *tsk)
+{
+	memset(&tsk->fault_stats, 0, sizeof(tsk->fault_stats));
+}
+
+#ifdef CONFIG_TASKSTATS
+void fault_stats_add_tsk(struct taskstats *stats, struct task_struct *tsk)
+{
+	const struct task_fault_stats *fs = &tsk->fault_stats;
+
+	stats->anon_fault_count += fs->count[FAULT_ANON];
+	stats->anon_fault_delay_total += fs->time[FAULT_ANON];
+	stats->file_fault_count += fs->count[FAULT_FILE];
+	stats->file_fault_delay_total += fs->time[FAULT_FILE];
+	stats->file_major_fault_count += fs->count[FAULT_FILE_MAJOR];
+	stats->file_major_fault_delay_total += fs->time[FAULT_FILE_MAJOR];
+	stats->swapin_fault_count += fs->count[FAULT_SWAPIN];
+	stats->swapin_fault_delay_total += fs->time[FAULT_SWAPIN];
+	stats->cow_fault_count += fs->count[FAULT_COW];
+	stats->cow_fault_delay_total += fs->time[FAULT_COW];
+	stats->other_fault_count += fs->count[FAULT_OTHER];
+	stats->other_fault_delay_total += fs->time[FAULT_OTHER];
+}
+#endif
+
+#ifdef CONFIG_PROC_FS
+static int faultstats_show(struct seq_file *m, void *v)
+{
+	struct fault_stats *sum;
+	int cpu, i, j;
+
+	sum = kzalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct fault_stats *fs = &per_cpu(fault_stats, cpu);
+
+		for (i = 0; i < NR_FAULT_STAT_ITEMS; i++) {
+			sum->count[i] += fs->count[i];
+			sum->time[i] += fs->time[i];
+			for (j = 0; j < FAULT_STAT_BUCKETS; j++)
+				sum->hist[i][j] += fs->hist[i][j];
+		}
+	}
+
+	seq_printf(m, "# type count time_ns, then faults by log2(usecs): "
+		   "<1 <2 <4 ... >=%lu\n", 1UL << (FAULT_STAT_BUCKETS - 2));
+	for (i = 0; i < NR_FAULT_STAT_ITEMS; i++) {
+		seq_printf(m, "%-10s %lu %llu", fault_stat_names[i],
+			   sum->count[i], (unsigned long long)sum->time[i]);
+		for (j = 0; j < FAULT_STAT_BUCKETS; j++)
+			seq_printf(m, " %lu", sum->hist[i][j]);
+		seq_putc(m, '\n');
+	}
+
+	kfree(sum);
+	return 0;
+}
+
+static int faultstats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, faultstats_show, NULL);
+}
+
+static const struct file_operations proc_faultstats_operations = {
+	.open		= faultstats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init faultstats_init(void)
+{
+	proc_create("faultstats", S_IRUGO, NULL, &proc_faultstats_operations);
+	return 0;
+}
+module_init(faultstats_init);
+#endif /* CONFIG_PROC_FS */
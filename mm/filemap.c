@@ -110,16 +110,80 @@
  *    ->i_mmap_lock
  */
 
+static void page_cache_tree_delete(struct address_space *mapping,
+				   struct page *page, void *shadow)
+{
+	struct radix_tree_node *node = NULL;
+	void **slot;
+	int tag;
+
+	if (!shadow) {
+		/* A node still holding shadow entries outlives the page */
+		if (mapping->nrshadows) {
+			__radix_tree_lookup(&mapping->page_tree, page->index,
+					    &node, &slot);
+			if (node && !workingset_node_shadows(node))
+				node = NULL;
+		}
+		radix_tree_delete(&mapping->page_tree, page->index);
+		if (node)
+			workingset_update_node(mapping, node, page->index);
+		return;
+	}
+
+	/*
+	 * Leave the shadow entry in the slot the page occupied, but
+	 * drop its tags: tagged lookups must never return one.
+	 */
+	for (tag = 0; tag < RADIX_TREE_MAX_TAGS; tag++)
+		radix_tree_tag_clear(&mapping->page_tree, page->index, tag);
+	__radix_tree_lookup(&mapping->page_tree, page->index, &node, &slot);
+	radix_tree_replace_slot(slot, shadow);
+	mapping->nrshadows++;
+	if (node) {
+		workingset_node_shadows_inc(node);
+		workingset_update_node(mapping, node, page->index);
+	}
+}
+
+/*
+ * Remove the shadow entry at @index from the page cache.  The caller
+ * must hold the mapping's tree_lock.
+ */
+void page_cache_tree_delete_shadow(struct address_space *mapping,
+				   pgoff_t index)
+{
+	struct radix_tree_node *node;
+	void **slot;
+
+	__radix_tree_lookup(&mapping->page_tree, index, &node, &slot);
+	mapping->nrshadows--;
+	if (node) {
+		workingset_node_shadows_dec(node);
+		/* Take it off the shadow list before it is freed */
+		if ((node->count & RADIX_TREE_COUNT_MASK) == 1) {
+			workingset_update_node(mapping, node, index);
+			node = NULL;
+		}
+	}
+	radix_tree_delete(&mapping->page_tree, index);
+	if (node)
+		workingset_update_node(mapping, node, index);
+}
+
 /*
  * Remove a page from the page cache and free it. Caller has to make
  * sure the page is locked and that nobody else uses it - or that usage
  * is safe.  The caller must hold the mapping's tree_lock.
+ *
+ * If @shadow is not NULL, it is left behind in the page cache in place
+ * of the page, see mm/workingset.c.
  */
-void __remove_from_page_cache(struct page *page)
+void __remove_from_page_cache(struct page *page, void *shadow)
 {
 	struct address_space *mapping = page->mapping;
 
-	radix_tree_delete(&mapping->page_tree, page->index);
+	page_cache_tree_delete(mapping, page, shadow);
 	page->mapping = NULL;
 	mapping->nrpages--;
 	__dec_zone_page_state(page, NR_FILE_PAGES);
@@ -149,7 +213,7 @@ void remove_from_page_cache(struct page *page)
 
 	freepage = mapping->a_ops->freepage;
 	spin_lock_irq(&mapping->tree_lock);
-	__remove_from_page_cache(page);
+	__remove_from_page_cache(page, NULL);
 	spin_unlock_irq(&mapping->tree_lock);
 	mem_cgroup_uncharge_cache_page(page);
 
@@ -390,17 +454,59 @@ int filemap_write_and_wait_range(struct address_space *mapping,
 EXPORT_SYMBOL(filemap_write_and_wait_range);
 
 /**
- * add_to_page_cache_locked - add a locked page to the pagecache
- * @page:	page to add
+ * page_cache_tree_insert - insert a page into the page cache radix tree
  * @mapping:	the page's address_space
- * @offset:	page index
- * @gfp_mask:	page allocation mode
+ * @page:	page to insert, with page->index set
+ * @shadowp:	returns the shadow entry the page replaced, if not NULL
  *
- * This function is used to add a page to the pagecache. It must be locked.
- * This function does not add the page to the LRU.  The caller must do that.
+ * Stores @page at page->index, taking over the slot of the shadow
+ * entry of an evicted page if there is one, and accounts it in
+ * @mapping->nrpages.  The caller must hold the mapping's tree_lock and
+ * have preloaded the radix tree.
  */
-int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
-		pgoff_t offset, gfp_t gfp_mask)
+int page_cache_tree_insert(struct address_space *mapping,
+			   struct page *page, void **shadowp)
+{
+	struct radix_tree_node *node;
+	void **slot;
+	void *p;
+	int error;
+
+	p = __radix_tree_lookup(&mapping->page_tree, page->index, &node, &slot);
+	if (p) {
+		if (!radix_tree_exceptional_entry(p))
+			return -EEXIST;
+		radix_tree_replace_slot(slot, page);
+		mapping->nrshadows--;
+		if (node) {
+			workingset_node_shadows_dec(node);
+			workingset_update_node(mapping, node, page->index);
+		}
+		if (shadowp)
+			*shadowp = p;
+	} else {
+		error = radix_tree_insert(&mapping->page_tree,
+					  page->index, page);
+		if (error)
+			return error;
+		/* The page may have joined a node of shadow entries */
+		if (mapping->nrshadows) {
+			__radix_tree_lookup(&mapping->page_tree, page->index,
+					    &node, &slot);
+			if (node)
+				workingset_update_node(mapping, node,
+						       page->index);
+		}
+	}
+	mapping->nrpages++;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(page_cache_tree_insert);
+
+static int __add_to_page_cache_locked(struct page *page,
+				      struct address_space *mapping,
+				      pgoff_t offset, gfp_t gfp_mask,
+				      void **shadowp)
 {
 	int error;
 
@@ -418,9 +524,8 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 		page->index = offset;
 
 		spin_lock_irq(&mapping->tree_lock);
-		error = radix_tree_insert(&mapping->page_tree, offset, page);
+		error = page_cache_tree_insert(mapping, page, shadowp);
 		if (likely(!error)) {
-			mapping->nrpages++;
 			__inc_zone_page_state(page, NR_FILE_PAGES);
 			if (PageSwapBacked(page))
 				__inc_zone_page_state(page, NR_SHMEM);
@@ -437,11 +542,29 @@ int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
 out:
 	return error;
 }
+
+/**
+ * add_to_page_cache_locked - add a locked page to the pagecache
+ * @page:	page to add
+ * @mapping:	the page's address_space
+ * @offset:	page index
+ * @gfp_mask:	page allocation mode
+ *
+ * This function is used to add a page to the pagecache. It must be locked.
+ * This function does not add the page to the LRU.  The caller must do that.
+ */
+int add_to_page_cache_locked(struct page *page, struct address_space *mapping,
+		pgoff_t offset, gfp_t gfp_mask)
+{
+	return __add_to_page_cache_locked(page, mapping, offset,
+					  gfp_mask, NULL);
+}
 EXPORT_SYMBOL(add_to_page_cache_locked);
 
 int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 				pgoff_t offset, gfp_t gfp_mask)
 {
+	void *shadow = NULL;
 	int ret;
 
 	/*
@@ -453,14 +576,27 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 	if (mapping_cap_swap_backed(mapping))
 		SetPageSwapBacked(page);
 
-	ret = add_to_page_cache(page, mapping, offset, gfp_mask);
-	if (ret == 0) {
-		if (page_is_file_cache(page))
-			lru_cache_add_file(page);
-		else
-			lru_cache_add_anon(page);
+	__set_page_locked(page);
+	ret = __add_to_page_cache_locked(page, mapping, offset,
+					 gfp_mask, &shadow);
+	if (unlikely(ret)) {
+		__clear_page_locked(page);
+		return ret;
 	}
-	return ret;
+
+	if (!page_is_file_cache(page))
+		lru_cache_add_anon(page);
+	else if (shadow && workingset_refault(shadow)) {
+		/*
+		 * The page was evicted recently enough that it would
+		 * have stayed resident with a bigger inactive list:
+		 * put it straight on the active list.
+		 */
+		workingset_activation(page);
+		lru_cache_add_active_file(page);
+	} else
+		lru_cache_add_file(page);
+	return 0;
 }
 EXPORT_SYMBOL_GPL(add_to_page_cache_lru);
 
@@ -630,6 +766,64 @@ int __lock_page_or_retry(struct page *page, struct mm_struct *mm,
 	}
 }
 
+/**
+ * page_cache_next_hole - find the next hole (not-present entry)
+ * @mapping: mapping
+ * @index: index
+ * @max_scan: maximum range to search
+ *
+ * Like radix_tree_next_hole(), but shadow entries of evicted pages
+ * count as holes.  May be called under rcu_read_lock.
+ */
+pgoff_t page_cache_next_hole(struct address_space *mapping,
+			     pgoff_t index, unsigned long max_scan)
+{
+	unsigned long i;
+
+	for (i = 0; i < max_scan; i++) {
+		struct page *page;
+
+		page = radix_tree_lookup(&mapping->page_tree, index);
+		if (!page || radix_tree_exceptional_entry(page))
+			break;
+		index++;
+		if (index == 0)
+			break;
+	}
+
+	return index;
+}
+EXPORT_SYMBOL(page_cache_next_hole);
+
+/**
+ * page_cache_prev_hole - find the prev hole (not-present entry)
+ * @mapping: mapping
+ * @index: index
+ * @max_scan: maximum range to search
+ *
+ * Like radix_tree_prev_hole(), but shadow entries of evicted pages
+ * count as holes.  May be called under rcu_read_lock.
+ */
+pgoff_t page_cache_prev_hole(struct address_space *mapping,
+			     pgoff_t index, unsigned long max_scan)
+{
+	unsigned long i;
+
+	for (i = 0; i < max_scan; i++) {
+		struct page *page;
+
+		page = radix_tree_lookup(&mapping->page_tree, index);
+		if (!page || radix_tree_exceptional_entry(page))
+			break;
+		index--;
+		if (index == ULONG_MAX)
+			break;
+	}
+
+	return index;
+}
+EXPORT_SYMBOL(page_cache_prev_hole);
+
 /**
  * find_get_page - find and get a page reference
  * @mapping: the address_space to search
@@ -653,6 +847,14 @@ repeat:
 			goto out;
 		if (radix_tree_deref_retry(page))
 			goto repeat;
+		/*
+		 * A shadow entry of a recently evicted page: the page
+		 * itself is not present.
+		 */
+		if (radix_tree_exceptional_entry(page)) {
+			page = NULL;
+			goto out;
+		}
 
 		if (!page_cache_get_speculative(page))
 			goto repeat;
@@ -751,6 +953,30 @@ repeat:
 }
 EXPORT_SYMBOL(find_or_create_page);
 
+/*
+ * Return the index of the first entry at or after @index that is not
+ * the shadow entry of an evicted page, or 0 if there is none.
+ * Must be called under rcu_read_lock.
+ */
+static pgoff_t page_cache_skip_shadows(struct address_space *mapping,
+				       pgoff_t index)
+{
+	unsigned long next;
+	void **slot;
+
+	while (radix_tree_gang_lookup_slot(&mapping->page_tree, &slot, &next,
+					   index, 1)) {
+		void *entry = radix_tree_deref_slot(slot);
+
+		if (entry && !radix_tree_exceptional_entry(entry))
+			return next;
+		index = next + 1;
+		if (index == 0)
+			break;
+	}
+	return 0;
+}
+
 /**
  * find_get_pages - gang pagecache lookup
  * @mapping:	The address_space to search
@@ -777,7 +1003,7 @@ unsigned find_get_pages(struct address_space *mapping, pgoff_t start,
 	rcu_read_lock();
 restart:
 	nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
-				(void ***)pages, start, nr_pages);
+				(void ***)pages, NULL, start, nr_pages);
 	ret = 0;
 	for (i = 0; i < nr_found; i++) {
 		struct page *page;
@@ -790,6 +1016,9 @@ repeat:
 				start = pages[ret-1]->index;
 			goto restart;
 		}
+		/* Skip over shadow entries of evicted pages */
+		if (radix_tree_exceptional_entry(page))
+			continue;
 
 		if (!page_cache_get_speculative(page))
 			goto repeat;
@@ -803,6 +1032,17 @@ repeat:
 		pages[ret] = page;
 		ret++;
 	}
+
+	/*
+	 * Callers take a zero return to mean there are no more pages,
+	 * so if a full batch held nothing but shadow entries, step
+	 * past them and look again.
+	 */
+	if (unlikely(!ret && nr_found == nr_pages)) {
+		start = page_cache_skip_shadows(mapping, start);
+		if (start)
+			goto restart;
+	}
 	rcu_read_unlock();
 	return ret;
 }
@@ -829,7 +1069,7 @@ unsigned find_get_pages_contig(struct address_space *mapping, pgoff_t index,
 	rcu_read_lock();
 restart:
 	nr_found = radix_tree_gang_lookup_slot(&mapping->page_tree,
-				(void ***)pages, index, nr_pages);
+				(void ***)pages, NULL, index, nr_pages);
 	ret = 0;
 	for (i = 0; i < nr_found; i++) {
 		struct page *page;
@@ -839,6 +1079,9 @@ repeat:
 			continue;
 		if (radix_tree_deref_retry(page))
 			goto restart;
+		/* A shadow entry is a hole in the range */
+		if (radix_tree_exceptional_entry(page))
+			break;
 
 		if (page->mapping == NULL || page->index != index)
 			break;
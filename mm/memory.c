@@ -901,6 +901,7 @@ static unsigned long zap_pte_range(struct mmu_gather *tlb,
 	init_rss_vec(rss);
 
 	pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
+	flush_tlb_batched_pending(mm);
 	arch_enter_lazy_mmu_mode();
 	do {
 		pte_t ptent = *pte;
@@ -3151,7 +3152,8 @@ static int do_nonlinear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
  */
 static inline int handle_pte_fault(struct mm_struct *mm,
 		struct vm_area_struct *vma, unsigned long address,
-		pte_t *pte, pmd_t *pmd, unsigned int flags)
+		pte_t *pte, pmd_t *pmd, unsigned int flags,
+		enum fault_stat_item *item)
 {
 	pte_t entry;
 	spinlock_t *ptl;
@@ -3160,16 +3162,22 @@ static inline int handle_pte_fault(struct mm_struct *mm,
 	if (!pte_present(entry)) {
 		if (pte_none(entry)) {
 			if (vma->vm_ops) {
-				if (likely(vma->vm_ops->fault))
+				if (likely(vma->vm_ops->fault)) {
+					*item = FAULT_FILE;
 					return do_linear_fault(mm, vma, address,
 						pte, pmd, flags, entry);
+				}
 			}
+			*item = FAULT_ANON;
 			return do_anonymous_page(mm, vma, address,
 						 pte, pmd, flags);
 		}
-		if (pte_file(entry))
+		if (pte_file(entry)) {
+			*item = FAULT_FILE;
 			return do_nonlinear_fault(mm, vma, address,
 					pte, pmd, flags, entry);
+		}
+		*item = FAULT_SWAPIN;
 		return do_swap_page(mm, vma, address,
 					pte, pmd, flags, entry);
 	}
@@ -3179,9 +3187,11 @@ static inline int handle_pte_fault(struct mm_struct *mm,
 	if (unlikely(!pte_same(*pte, entry)))
 		goto unlock;
 	if (flags & FAULT_FLAG_WRITE) {
-		if (!pte_write(entry))
+		if (!pte_write(entry)) {
+			*item = FAULT_COW;
 			return do_wp_page(mm, vma, address,
 					pte, pmd, ptl, entry);
+		}
 		entry = pte_mkdirty(entry);
 	}
 	entry = pte_mkyoung(entry);
@@ -3202,11 +3212,9 @@ unlock:
 	return 0;
 }
 
-/*
- * By the time we get here, we already hold the mm semaphore
- */
-int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
-		unsigned long address, unsigned int flags)
+static int __handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
+		unsigned long address, unsigned int flags,
+		enum fault_stat_item *item)
 {
 	pgd_t *pgd;
 	pud_t *pud;
@@ -3234,7 +3242,22 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	if (!pte)
 		return VM_FAULT_OOM;
 
-	return handle_pte_fault(mm, vma, address, pte, pmd, flags);
+	return handle_pte_fault(mm, vma, address, pte, pmd, flags, item);
+}
+
+/*
+ * By the time we get here, we already hold the mm semaphore
+ */
+int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
+		unsigned long address, unsigned int flags)
+{
+	enum fault_stat_item item = FAULT_OTHER;
+	u64 start = fault_stats_clock();
+	int ret;
+
+	ret = __handle_mm_fault(mm, vma, address, flags, &item);
+	fault_stats_account(address, item, ret, start);
+	return ret;
 }
 
 #ifndef __PAGETABLE_PUD_FOLDED
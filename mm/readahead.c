@@ -18,6 +18,9 @@
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/readahead.h>
+
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
  * memset *ra to zero.
@@ -109,9 +112,12 @@ EXPORT_SYMBOL(read_cache_pages);
 static int read_pages(struct address_space *mapping, struct file *filp,
 		struct list_head *pages, unsigned nr_pages)
 {
+	struct blk_plug plug;
 	unsigned page_idx;
 	int ret;
 
+	blk_start_plug(&plug);
+
 	if (mapping->a_ops->readpages) {
 		ret = mapping->a_ops->readpages(filp, mapping, pages, nr_pages);
 		/* Clean up the remaining pages */
@@ -129,7 +135,10 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 		page_cache_release(page);
 	}
 	ret = 0;
+
 out:
+	blk_finish_plug(&plug);
+
 	return ret;
 }
 
@@ -171,7 +180,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		rcu_read_lock();
 		page = radix_tree_lookup(&mapping->page_tree, page_offset);
 		rcu_read_unlock();
-		if (page)
+		if (page && !radix_tree_exceptional_entry(page))
 			continue;
 
 		page = page_cache_alloc_cold(mapping);
@@ -328,8 +337,72 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  *
  * The code ramps up the readahead size aggressively at first, but slow down as
  * it approaches max_readhead.
+ *
+ * Besides the current readahead window, up to RA_STREAMS windows of other
+ * sequential streams on the same fd are remembered in ra->streams.  A read
+ * that falls into or right after one of them swaps it with the current
+ * window, so each of several interleaved streams keeps ramping up its own
+ * window instead of collapsing to small reads.  Reads that start a new
+ * stream push the current window into ra->streams, evicting the least
+ * recently used one.  Random reads leave all of them alone.
  */
 
+/*
+ * Save the current window in ra->streams before a new stream replaces it,
+ * unless @offset continues it.
+ */
+static void ra_save_stream(struct file_ra_state *ra, pgoff_t offset)
+{
+	if (!ra->size)
+		return;
+	if (offset >= ra->start && offset <= ra->start + ra->size)
+		return;
+
+	memmove(&ra->streams[1], &ra->streams[0],
+		(RA_STREAMS - 1) * sizeof(ra->streams[0]));
+	ra->streams[0].start = ra->start;
+	ra->streams[0].size = ra->size;
+	ra->streams[0].async_size = ra->async_size;
+}
+
+/*
+ * If @offset is in or right after the window of another tracked stream,
+ * make that stream the current one.
+ */
+static bool ra_switch_stream(struct file_ra_state *ra, pgoff_t offset)
+{
+	struct file_ra_stream cur = {
+		.start = ra->start,
+		.size = ra->size,
+		.async_size = ra->async_size,
+	};
+	struct file_ra_stream *s;
+	int i;
+
+	for (i = 0; i < RA_STREAMS; i++) {
+		s = &ra->streams[i];
+		if (s->size && offset >= s->start &&
+		    offset <= s->start + s->size)
+			break;
+	}
+	if (i == RA_STREAMS)
+		return false;
+
+	ra->start = s->start;
+	ra->size = s->size;
+	ra->async_size = s->async_size;
+
+	memmove(&ra->streams[1], &ra->streams[0], i * sizeof(ra->streams[0]));
+	ra->streams[0] = cur;
+	return true;
+}
+
+static inline bool ra_expected(struct file_ra_state *ra, pgoff_t offset)
+{
+	return offset == (ra->start + ra->size - ra->async_size) ||
+	       offset == (ra->start + ra->size);
+}
+
 /*
  * Count contiguously cached pages from @offset-1 to @offset-@max,
  * this count is a conservative estimation of
@@ -343,7 +416,7 @@ static pgoff_t count_history_pages(struct address_space *mapping,
 	pgoff_t head;
 
 	rcu_read_lock();
-	head = radix_tree_prev_hole(&mapping->page_tree, offset - 1, max);
+	head = page_cache_prev_hole(mapping, offset - 1, max);
 	rcu_read_unlock();
 
 	return offset - 1 - head;
@@ -376,6 +449,7 @@ static int try_context_readahead(struct address_space *mapping,
 	if (size >= offset)
 		size *= 2;
 
+	ra_save_stream(ra, offset);
 	ra->start = offset;
 	ra->size = get_init_ra_size(size + req_size, max);
 	ra->async_size = ra->size;
@@ -392,20 +466,28 @@ ondemand_readahead(struct address_space *mapping,
 		   bool hit_readahead_marker, pgoff_t offset,
 		   unsigned long req_size)
 {
+	struct backing_dev_info *bdi = mapping->backing_dev_info;
 	unsigned long max = max_sane_readahead(ra->ra_pages);
+	int pattern;
+	int actual;
 
 	/*
 	 * start of file
 	 */
-	if (!offset)
+	if (!offset) {
+		pattern = RA_PATTERN_INITIAL;
 		goto initial_readahead;
+	}
 
 	/*
 	 * It's the expected callback offset, assume sequential access.
 	 * Ramp up sizes, and push forward the readahead window.
+	 * The offset may also belong to another stream we track.
 	 */
-	if ((offset == (ra->start + ra->size - ra->async_size) ||
-	     offset == (ra->start + ra->size))) {
+	pattern = RA_PATTERN_SEQUENTIAL;
+	if (!ra_expected(ra, offset) && ra_switch_stream(ra, offset))
+		pattern = RA_PATTERN_STREAM;
+	if (ra_expected(ra, offset)) {
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
@@ -422,46 +504,59 @@ ondemand_readahead(struct address_space *mapping,
 		pgoff_t start;
 
 		rcu_read_lock();
-		start = radix_tree_next_hole(&mapping->page_tree, offset+1,max);
+		start = page_cache_next_hole(mapping, offset+1, max);
 		rcu_read_unlock();
 
 		if (!start || start - offset > max)
 			return 0;
 
+		ra_save_stream(ra, offset);
 		ra->start = start;
 		ra->size = start - offset;	/* old async_size */
 		ra->size += req_size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
+		pattern = RA_PATTERN_MARKER;
 		goto readit;
 	}
 
 	/*
 	 * oversize read
 	 */
-	if (req_size > max)
+	if (req_size > max) {
+		pattern = RA_PATTERN_OVERSIZE;
 		goto initial_readahead;
+	}
 
 	/*
 	 * sequential cache miss
 	 */
-	if (offset - (ra->prev_pos >> PAGE_CACHE_SHIFT) <= 1UL)
+	if (offset - (ra->prev_pos >> PAGE_CACHE_SHIFT) <= 1UL) {
+		pattern = RA_PATTERN_INITIAL;
 		goto initial_readahead;
+	}
 
 	/*
 	 * Query the page cache and look for the traces(cached history pages)
 	 * that a sequential stream would leave behind.
 	 */
-	if (try_context_readahead(mapping, ra, offset, req_size, max))
+	if (try_context_readahead(mapping, ra, offset, req_size, max)) {
+		pattern = RA_PATTERN_CONTEXT;
 		goto readit;
+	}
 
 	/*
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
 	 */
-	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
+	actual = __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
+	inc_bdi_stat(bdi, BDI_READAHEAD_MISS);
+	trace_readahead(mapping, offset, req_size, ra, RA_PATTERN_RANDOM,
+			actual);
+	return actual;
 
 initial_readahead:
+	ra_save_stream(ra, offset);
 	ra->start = offset;
 	ra->size = get_init_ra_size(req_size, max);
 	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
@@ -477,7 +572,13 @@ readit:
 		ra->size += ra->async_size;
 	}
 
-	return ra_submit(ra, mapping, filp);
+	actual = ra_submit(ra, mapping, filp);
+	if (pattern == RA_PATTERN_SEQUENTIAL || pattern == RA_PATTERN_STREAM)
+		inc_bdi_stat(bdi, BDI_READAHEAD_HIT);
+	else
+		inc_bdi_stat(bdi, BDI_READAHEAD_MISS);
+	trace_readahead(mapping, offset, req_size, ra, pattern, actual);
+	return actual;
 }
 
 /**
@@ -0,0 +1,280 @@
+/*
+ * Workingset detection
+ */
+
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/fs.h>
+#include <linux/radix-tree.h>
+#include <linux/spinlock.h>
+#include <linux/vmstat.h>
+#include <linux/init.h>
+
+/*
+ *		Double CLOCK lists
+ *
+ * Per zone, two clock lists are maintained for file pages: the
+ * inactive and the active list.  Freshly faulted pages start out at
+ * the head of the inactive list and page reclaim scans pages from the
+ * tail.  Pages that are accessed multiple times on the inactive list
+ * are promoted to the active list, to protect them from reclaim,
+ * whereas active pages are demoted to the inactive list when the
+ * active list grows too big.
+ *
+ * The size of the lists is balanced with a fixed ratio, so a page
+ * that is part of the workingset but is accessed less often than the
+ * inactive list turns over is evicted before it can be promoted: a
+ * streaming read of a large file pushes the real workingset out.
+ *
+ *		Approximating inactive page access frequency
+ *
+ * The zone maintains a counter, zone->inactive_age, which is advanced
+ * on every file page eviction and every activation.  When a page is
+ * evicted, a snapshot of that counter is stored in the page cache
+ * radix tree slot the page occupied, as a "shadow entry".
+ *
+ * When the page faults back in, the difference between the current
+ * counter and the snapshot is the refault distance: the minimum number
+ * of additional inactive slots the page would have needed to stay
+ * resident.  If that distance is no bigger than the active list, the
+ * page could have stayed in memory by sacrificing active pages of
+ * unknown use, so it is activated straight away and left to compete
+ * with the existing active pages.
+ *
+ *		Implementation
+ *
+ * Shadow entries are exceptional radix tree entries: besides the
+ * eviction counter they encode the zone, since the refaulting page
+ * is likely allocated from a different one.  They are removed when
+ * the page is faulted back in, when the mapping is truncated and
+ * when the inode is evicted.
+ *
+ * A file that was read once and then evicted would otherwise keep
+ * radix tree nodes full of shadow entries around for as long as its
+ * inode is cached.  Each radix tree node counts the shadow entries it
+ * holds in the upper bits of node->count, and nodes that hold nothing
+ * but shadow entries are kept on a global list, which a shrinker
+ * trims from the oldest end when there are more of them than can be
+ * useful.
+ */
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow, struct zone **zone,
+			  unsigned long *distance)
+{
+	unsigned long entry = (unsigned long)shadow;
+	unsigned long refault;
+	unsigned long mask;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+
+	refault = atomic_long_read(&(*zone)->inactive_age);
+	mask = ~0UL >> (NODES_SHIFT + ZONES_SHIFT +
+			RADIX_TREE_EXCEPTIONAL_SHIFT);
+	/*
+	 * The unsigned subtraction gives an accurate distance across
+	 * inactive_age overflows.  A shadow entry that lives long enough
+	 * to be lapped by the counter yields a falsely small distance;
+	 * the worst outcome is one unwarranted activation.
+	 */
+	*distance = (refault - entry) & mask;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from memory
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Returns a shadow entry to be stored in @mapping->page_tree in place
+ * of the evicted @page so that a later refault can be detected.
+ */
+void *workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	return pack_shadow(eviction, zone);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: shadow entry of the evicted page
+ *
+ * Calculates and evaluates the refault distance of the previously
+ * evicted page in the context of the zone it was allocated in.
+ *
+ * Returns %true if the page should be activated, %false otherwise.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &refault_distance);
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+/*
+ * Radix tree nodes that contain only shadow entries, oldest first.
+ * A node is added and removed with its mapping's tree_lock held, so
+ * its list membership is stable under the tree_lock alone.
+ */
+static LIST_HEAD(shadow_nodes);
+static DEFINE_SPINLOCK(shadow_nodes_lock);
+static unsigned long nr_shadow_nodes;
+
+/**
+ * workingset_update_node - track a page cache node holding shadow entries
+ * @mapping: address space the node belongs to
+ * @node: bottom-level radix tree node whose entries changed
+ * @index: index of one of the node's entries
+ *
+ * Puts @node on the shadow node list if it holds nothing but shadow
+ * entries now, and takes it off otherwise.  Must be called with
+ * @mapping->tree_lock held, after every change to the entries of a
+ * node that may hold shadow entries and before the node can be freed.
+ */
+void workingset_update_node(struct address_space *mapping,
+			    struct radix_tree_node *node, unsigned long index)
+{
+	unsigned int shadows = workingset_node_shadows(node);
+	bool only_shadows;
+
+	only_shadows = shadows &&
+		       shadows == (node->count & RADIX_TREE_COUNT_MASK);
+	if (only_shadows == !list_empty(&node->private_list))
+		return;
+
+	spin_lock(&shadow_nodes_lock);
+	if (only_shadows) {
+		node->private_data = mapping;
+		node->index = index & ~RADIX_TREE_MAP_MASK;
+		list_add_tail(&node->private_list, &shadow_nodes);
+		nr_shadow_nodes++;
+	} else {
+		list_del_init(&node->private_list);
+		nr_shadow_nodes--;
+	}
+	spin_unlock(&shadow_nodes_lock);
+}
+
+/*
+ * Active file pages are limited to half of memory, and shadow entries
+ * whose refault distance is bigger than that have no effect.  Keep no
+ * more shadow nodes than it takes to cover that many pages when only
+ * every eighth slot of a node is in use.  On 64-bit, this leaves the
+ * nodes around 2% of memory.
+ */
+static unsigned long max_shadow_nodes(void)
+{
+	return totalram_pages >> (1 + RADIX_TREE_MAP_SHIFT - 3);
+}
+
+/*
+ * Drop the shadow entries of @node, which frees it.  Called with the
+ * shadow node list and the tree_lock of the node's mapping held.
+ */
+static void shadow_node_reclaim(struct radix_tree_node *node)
+{
+	struct address_space *mapping = node->private_data;
+	unsigned long index = node->index;
+	unsigned int i, nr;
+
+	list_del_init(&node->private_list);
+	nr_shadow_nodes--;
+	inc_zone_state(page_zone(virt_to_page(node)), WORKINGSET_NODERECLAIM);
+
+	nr = workingset_node_shadows(node);
+	for (i = 0; nr && i < RADIX_TREE_MAP_SIZE; i++) {
+		if (!node->slots[i])
+			continue;
+		BUG_ON(!radix_tree_exceptional_entry(node->slots[i]));
+		workingset_node_shadows_dec(node);
+		mapping->nrshadows--;
+		/* The last one frees the node */
+		nr--;
+		radix_tree_delete(&mapping->page_tree, index + i);
+	}
+}
+
+static int shrink_shadow_nodes(struct shrinker *shrink, int nr_to_scan,
+			       gfp_t gfp_mask)
+{
+	unsigned long max_nodes = max_shadow_nodes();
+	unsigned long nr;
+
+	if (nr_to_scan) {
+		spin_lock_irq(&shadow_nodes_lock);
+		while (nr_to_scan-- && nr_shadow_nodes > max_nodes) {
+			struct radix_tree_node *node;
+			struct address_space *mapping;
+
+			node = list_first_entry(&shadow_nodes,
+						struct radix_tree_node,
+						private_list);
+			mapping = node->private_data;
+			/*
+			 * The lock order is tree_lock -> shadow_nodes_lock,
+			 * so only try.  A busy mapping goes to the back of
+			 * the list.
+			 */
+			if (!spin_trylock(&mapping->tree_lock)) {
+				list_move_tail(&node->private_list,
+					       &shadow_nodes);
+				continue;
+			}
+			shadow_node_reclaim(node);
+			spin_unlock(&mapping->tree_lock);
+		}
+		spin_unlock_irq(&shadow_nodes_lock);
+	}
+
+	nr = ACCESS_ONCE(nr_shadow_nodes);
+	if (nr <= max_nodes)
+		return 0;
+	return min_t(unsigned long, nr - max_nodes, INT_MAX);
+}
+
+static struct shrinker shadow_nodes_shrinker = {
+	.shrink = shrink_shadow_nodes,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int __init workingset_init(void)
+{
+	register_shrinker(&shadow_nodes_shrinker);
+	return 0;
+}
+module_init(workingset_init);
@@ -130,6 +130,7 @@
 #include <trace/events/napi.h>
 #include <trace/events/net.h>
 #include <trace/events/skb.h>
+#include <net/busy_poll.h>
 #include <linux/pci.h>
 #include <linux/inetdevice.h>
 
@@ -1553,6 +1554,12 @@ static void dev_queue_xmit_nit(struct sk_buff *skb, struct net_device *dev)
 
 			skb2->transport_header = skb2->network_header;
 			skb2->pkt_type = PACKET_OUTGOING;
+
+			/* Taps may hold on to it: do not pin user pages */
+			if (unlikely(skb_orphan_frags_rx(skb2, GFP_ATOMIC))) {
+				kfree_skb(skb2);
+				break;
+			}
 			ptype->func(skb2, skb->dev, ptype, skb->dev);
 		}
 	}
@@ -1569,8 +1576,15 @@ int netif_set_real_num_tx_queues(struct net_device *dev, unsigned int txq)
 		return -EINVAL;
 
 	if (dev->reg_state == NETREG_REGISTERED) {
+		int rc;
+
 		ASSERT_RTNL();
 
+		rc = netdev_queue_update_kobjects(dev, dev->real_num_tx_queues,
+						  txq);
+		if (rc)
+			return rc;
+
 		if (txq < dev->real_num_tx_queues)
 			qdisc_reset_all_tx_gt(dev, txq);
 	}
@@ -1860,6 +1874,74 @@ struct sk_buff *skb_gso_segment(struct sk_buff *skb, int features)
 }
 EXPORT_SYMBOL(skb_gso_segment);
 
+/**
+ *	skb_tunnel_gso_segment - Perform segmentation on a tunnelled skb.
+ *	@skb: buffer to segment, data pointing at the tunnel header
+ *	@features: features for the output path (see dev->features)
+ *	@hlen: length of the tunnel header
+ *	@type: ethertype of the packet following the tunnel header
+ *
+ *	Segments the inner packet of a GRO aggregated tunnel packet, treating
+ *	all the outer headers as its link layer header so that skb_segment()
+ *	copies them into every segment.  The header offsets, mac_len and
+ *	protocol of the segments are those of the outer packet on return,
+ *	fixing up the outer headers is left to the caller.
+ */
+struct sk_buff *skb_tunnel_gso_segment(struct sk_buff *skb, int features,
+				       unsigned int hlen, __be16 type)
+{
+	struct sk_buff *segs = ERR_PTR(-EPROTONOSUPPORT);
+	int doffset = skb->data - skb_mac_header(skb);
+	int nhoff = skb->network_header - skb->mac_header;
+	int thoff = skb->transport_header - skb->mac_header;
+	int mac_len = skb->mac_len;
+	__be16 protocol = skb->protocol;
+	struct packet_type *ptype;
+
+	if (unlikely(!pskb_may_pull(skb, hlen)))
+		return ERR_PTR(-EINVAL);
+
+	/* A device only parsing the outer headers cannot checksum the
+	 * inner packet, have the inner segments checksummed in software.
+	 */
+	if (!(features & NETIF_F_GEN_CSUM))
+		features &= ~(NETIF_F_ALL_CSUM | NETIF_F_SG);
+
+	__skb_pull(skb, hlen);
+	skb_reset_network_header(skb);
+	skb->mac_len = skb->network_header - skb->mac_header;
+	skb->protocol = type;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ptype,
+			&ptype_base[ntohs(type) & PTYPE_HASH_MASK], list) {
+		if (ptype->type == type && !ptype->dev && ptype->gso_segment) {
+			segs = ptype->gso_segment(skb, features);
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	__skb_push(skb, skb->data - skb_mac_header(skb) - doffset);
+	skb_set_network_header(skb, nhoff - doffset);
+	skb_set_transport_header(skb, thoff - doffset);
+	skb->mac_len = mac_len;
+	skb->protocol = protocol;
+
+	if (!segs || IS_ERR(segs))
+		return segs;
+
+	for (skb = segs; skb; skb = skb->next) {
+		skb_set_network_header(skb, nhoff);
+		skb_set_transport_header(skb, thoff);
+		skb->mac_len = mac_len;
+		skb->protocol = protocol;
+	}
+
+	return segs;
+}
+EXPORT_SYMBOL(skb_tunnel_gso_segment);
+
 /* Take action when hardware reception checksum errors are detected. */
 #ifdef CONFIG_BUG
 void netdev_rx_csum_fault(struct net_device *dev)
@@ -1956,25 +2038,6 @@ static int dev_gso_segment(struct sk_buff *skb)
 	return 0;
 }
 
-/*
- * Try to orphan skb early, right before transmission by the device.
- * We cannot orphan skb if tx timestamp is requested or the sk-reference
- * is needed on driver level for other reasons, e.g. see net/can/raw.c
- */
-static inline void skb_orphan_try(struct sk_buff *skb)
-{
-	struct sock *sk = skb->sk;
-
-	if (sk && !skb_shinfo(skb)->tx_flags) {
-		/* skb_tx_hash() wont be able to get sk.
-		 * We copy sk_hash into skb->rxhash
-		 */
-		if (!skb->rxhash)
-			skb->rxhash = sk->sk_hash;
-		skb_orphan(skb);
-	}
-}
-
 /*
  * Returns true if either:
  *	1. skb has frag_list and the device doesn't support FRAGLIST, or
@@ -2013,8 +2076,6 @@ int dev_hard_start_xmit(struct sk_buff *skb, struct net_device *dev,
 		if (dev->priv_flags & IFF_XMIT_DST_RELEASE)
 			skb_dst_drop(skb);
 
-		skb_orphan_try(skb);
-
 		if (vlan_tx_tag_present(skb) &&
 		    !(dev->features & NETIF_F_HW_VLAN_TX)) {
 			skb = __vlan_put_tag(skb, vlan_tx_tag_get(skb));
@@ -2078,7 +2139,7 @@ gso:
 			return rc;
 		}
 		txq_trans_update(txq);
-		if (unlikely(netif_tx_queue_stopped(txq) && skb->next))
+		if (unlikely(netif_xmit_stopped(txq) && skb->next))
 			return NETDEV_TX_BUSY;
 	} while (skb->next);
 
@@ -2127,6 +2188,44 @@ static inline u16 dev_cap_txqueue(struct net_device *dev, u16 queue_index)
 	return queue_index;
 }
 
+static inline int get_xps_queue(struct net_device *dev, struct sk_buff *skb)
+{
+#ifdef CONFIG_XPS
+	struct xps_dev_maps *dev_maps;
+	struct xps_map *map;
+	int queue_index = -1;
+
+	rcu_read_lock();
+	dev_maps = rcu_dereference(dev->xps_maps);
+	if (dev_maps) {
+		map = rcu_dereference(
+		    dev_maps->cpu_map[raw_smp_processor_id()]);
+		if (map) {
+			if (map->len == 1)
+				queue_index = map->queues[0];
+			else {
+				u32 hash;
+				if (skb->sk && skb->sk->sk_hash)
+					hash = skb->sk->sk_hash;
+				else
+					hash = (__force u16) skb->protocol ^
+					    skb->rxhash;
+				hash = jhash_1word(hash, hashrnd);
+				queue_index = map->queues[
+				    ((u64)hash * map->len) >> 32];
+			}
+			if (unlikely(queue_index >= dev->real_num_tx_queues))
+				queue_index = -1;
+		}
+	}
+	rcu_read_unlock();
+
+	return queue_index;
+#else
+	return -1;
+#endif
+}
+
 static struct netdev_queue *dev_pick_tx(struct net_device *dev,
 					struct sk_buff *skb)
 {
@@ -2139,14 +2238,20 @@ static struct netdev_queue *dev_pick_tx(struct net_device *dev,
 	} else {
 		struct sock *sk = skb->sk;
 		queue_index = sk_tx_queue_get(sk);
-		if (queue_index < 0 || queue_index >= dev->real_num_tx_queues) {
 
+		if (dev->real_num_tx_queues == 1)
 			queue_index = 0;
-			if (dev->real_num_tx_queues > 1)
+		else if (queue_index < 0 || skb->ooo_okay ||
+			 queue_index >= dev->real_num_tx_queues) {
+			int old_index = queue_index;
+
+			queue_index = get_xps_queue(dev, skb);
+			if (queue_index < 0)
 				queue_index = skb_tx_hash(dev, skb);
 
-			if (sk) {
-				struct dst_entry *dst = rcu_dereference_check(sk->sk_dst_cache, 1);
+			if (queue_index != old_index && sk) {
+				struct dst_entry *dst =
+				    rcu_dereference_check(sk->sk_dst_cache, 1);
 
 				if (dst && skb_dst(skb) == dst)
 					sk_tx_queue_set(sk, queue_index);
@@ -2290,7 +2395,7 @@ int dev_queue_xmit(struct sk_buff *skb)
 
 			HARD_TX_LOCK(dev, txq, cpu);
 
-			if (!netif_tx_queue_stopped(txq)) {
+			if (!netif_xmit_stopped(txq)) {
 				__this_cpu_inc(xmit_recursion);
 				rc = dev_hard_start_xmit(skb, dev, txq);
 				__this_cpu_dec(xmit_recursion);
@@ -2724,6 +2829,8 @@ static inline int deliver_skb(struct sk_buff *skb,
 			      struct packet_type *pt_prev,
 			      struct net_device *orig_dev)
 {
+	if (unlikely(skb_orphan_frags_rx(skb, GFP_ATOMIC)))
+		return -ENOMEM;
 	atomic_inc(&skb->users);
 	return pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
 }
@@ -3018,7 +3125,7 @@ ncls:
 		}
 	}
 
-	if (pt_prev) {
+	if (pt_prev && likely(!skb_orphan_frags_rx(skb, GFP_ATOMIC))) {
 		ret = pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
 	} else {
 		atomic_long_inc(&skb->dev->rx_dropped);
@@ -3127,7 +3234,7 @@ static int napi_gro_complete(struct sk_buff *skb)
 		if (ptype->type != type || ptype->dev || !ptype->gro_complete)
 			continue;
 
-		err = ptype->gro_complete(skb);
+		err = ptype->gro_complete(skb, 0);
 		break;
 	}
 	rcu_read_unlock();
@@ -3142,6 +3249,35 @@ out:
 	return netif_receive_skb(skb);
 }
 
+/* Find the packet_type handling GRO for the packet following a tunnel
+ * header, called under rcu_read_lock().
+ */
+struct packet_type *gro_find_receive_by_type(__be16 type)
+{
+	struct list_head *head = &ptype_base[ntohs(type) & PTYPE_HASH_MASK];
+	struct packet_type *ptype;
+
+	list_for_each_entry_rcu(ptype, head, list) {
+		if (ptype->type == type && !ptype->dev && ptype->gro_receive)
+			return ptype;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL(gro_find_receive_by_type);
+
+struct packet_type *gro_find_complete_by_type(__be16 type)
+{
+	struct list_head *head = &ptype_base[ntohs(type) & PTYPE_HASH_MASK];
+	struct packet_type *ptype;
+
+	list_for_each_entry_rcu(ptype, head, list) {
+		if (ptype->type == type && !ptype->dev && ptype->gro_complete)
+			return ptype;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL(gro_find_complete_by_type);
+
 inline void napi_gro_flush(struct napi_struct *napi)
 {
 	struct sk_buff *skb, *next;
@@ -3184,6 +3320,7 @@ enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 		NAPI_GRO_CB(skb)->same_flow = 0;
 		NAPI_GRO_CB(skb)->flush = 0;
 		NAPI_GRO_CB(skb)->free = 0;
+		NAPI_GRO_CB(skb)->encap = 0;
 
 		pp = ptype->gro_receive(&napi->gro_list, skb);
 		break;
@@ -3512,14 +3649,56 @@ void __napi_schedule(struct napi_struct *n)
 }
 EXPORT_SYMBOL(__napi_schedule);
 
+/**
+ *	napi_schedule_prep - check if napi can be scheduled
+ *	@n: napi context
+ *
+ * Test if NAPI routine is already running, and if not mark
+ * it as running.  This is used as a condition variable
+ * insure only one NAPI poll instance runs.  We also make
+ * sure there is no pending NAPI disable.
+ *
+ * If the poll routine is already running, NAPI_STATE_MISSED is set so
+ * that the running instance polls once more before completing: a busy
+ * polling socket may own the NAPI while the device interrupt fires.
+ */
+int napi_schedule_prep(struct napi_struct *n)
+{
+	unsigned long val, new;
+
+	do {
+		val = ACCESS_ONCE(n->state);
+		if (unlikely(val & NAPIF_STATE_DISABLE))
+			return 0;
+		new = val | NAPIF_STATE_SCHED;
+		if (val & NAPIF_STATE_SCHED)
+			new |= NAPIF_STATE_MISSED;
+	} while (cmpxchg(&n->state, val, new) != val);
+
+	return !(val & NAPIF_STATE_SCHED);
+}
+EXPORT_SYMBOL(napi_schedule_prep);
+
 void __napi_complete(struct napi_struct *n)
 {
+	unsigned long val, new;
+
 	BUG_ON(!test_bit(NAPI_STATE_SCHED, &n->state));
 	BUG_ON(n->gro_list);
 
-	list_del(&n->poll_list);
-	smp_mb__before_clear_bit();
-	clear_bit(NAPI_STATE_SCHED, &n->state);
+	/* Not on a poll_list when completed from busy polling */
+	list_del_init(&n->poll_list);
+
+	do {
+		val = ACCESS_ONCE(n->state);
+		new = val & ~(NAPIF_STATE_MISSED | NAPIF_STATE_SCHED);
+		/* A schedule was missed: stay scheduled, poll again */
+		if (val & NAPIF_STATE_MISSED)
+			new |= NAPIF_STATE_SCHED;
+	} while (cmpxchg(&n->state, val, new) != val);
+
+	if (unlikely(val & NAPIF_STATE_MISSED))
+		__napi_schedule(n);
 }
 EXPORT_SYMBOL(__napi_complete);
 
@@ -3541,6 +3720,166 @@ void napi_complete(struct napi_struct *n)
 }
 EXPORT_SYMBOL(napi_complete);
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+#define NAPI_HASH_BITS	8
+
+static DEFINE_SPINLOCK(napi_hash_lock);
+static struct hlist_head napi_hash[1 << NAPI_HASH_BITS];
+static unsigned int napi_gen_id;
+
+unsigned int sysctl_net_busy_read __read_mostly;
+
+/* must be called under rcu_read_lock(), as we dont take a reference */
+static struct napi_struct *napi_by_id(unsigned int napi_id)
+{
+	struct napi_struct *napi;
+	struct hlist_node *node;
+
+	hlist_for_each_entry_rcu(napi, node,
+				 &napi_hash[hash_32(napi_id, NAPI_HASH_BITS)],
+				 napi_hash_node)
+		if (napi->napi_id == napi_id)
+			return napi;
+
+	return NULL;
+}
+
+void napi_hash_add(struct napi_struct *napi)
+{
+	if (test_and_set_bit(NAPI_STATE_HASHED, &napi->state))
+		return;
+
+	spin_lock(&napi_hash_lock);
+
+	/* 0 is not a valid id, we also skip an id that is taken
+	 * we expect both events to be extremely rare
+	 */
+	do {
+		if (unlikely(++napi_gen_id == 0))
+			napi_gen_id = 1;
+	} while (napi_by_id(napi_gen_id));
+	napi->napi_id = napi_gen_id;
+
+	hlist_add_head_rcu(&napi->napi_hash_node,
+			   &napi_hash[hash_32(napi->napi_id, NAPI_HASH_BITS)]);
+
+	spin_unlock(&napi_hash_lock);
+}
+EXPORT_SYMBOL_GPL(napi_hash_add);
+
+/* Returns true if @napi was hashed: the caller must then wait for
+ * a RCU grace period before freeing it.
+ */
+static bool napi_hash_del(struct napi_struct *napi)
+{
+	if (!test_and_clear_bit(NAPI_STATE_HASHED, &napi->state))
+		return false;
+
+	spin_lock(&napi_hash_lock);
+	hlist_del_rcu(&napi->napi_hash_node);
+	spin_unlock(&napi_hash_lock);
+	return true;
+}
+
+#define BUSY_POLL_BUDGET 8
+
+/* Run one round of @napi's poll routine from process context, unless
+ * NET_RX softirq or another busy poller is already running it.
+ * Returns the number of packets processed.
+ */
+static int napi_busy_poll(struct napi_struct *napi)
+{
+	unsigned long val;
+	void *have;
+	int work = 0;
+
+	local_bh_disable();
+
+	/* Unlike napi_schedule_prep(), never set NAPI_STATE_MISSED: that
+	 * would make the current owner poll again after every failed
+	 * attempt, for as long as the socket keeps spinning.
+	 */
+	val = ACCESS_ONCE(napi->state);
+	if (val & (NAPIF_STATE_DISABLE | NAPIF_STATE_SCHED))
+		goto out;
+	if (cmpxchg(&napi->state, val, val | NAPIF_STATE_SCHED) != val)
+		goto out;
+
+	have = netpoll_poll_lock(napi);
+	work = napi->poll(napi, BUSY_POLL_BUDGET);
+	trace_napi_poll(napi);
+	netpoll_poll_unlock(have);
+
+	/* With the budget used up, the driver left NAPI scheduled for
+	 * more work: hand it to NET_RX softirq like net_rx_action() would.
+	 */
+	if (work == BUSY_POLL_BUDGET)
+		__napi_schedule(napi);
+out:
+	local_bh_enable();
+	return work;
+}
+
+static inline u64 busy_loop_us_clock(void)
+{
+	return local_clock() >> 10;
+}
+
+/**
+ *	sk_busy_loop - busy poll the receive queue of a socket's last packet
+ *	@sk: socket, with sk_ll_usec and sk_napi_id set
+ *	@nonblock: poll only once
+ *
+ * Runs the NAPI poll routine the socket's packets arrive through until
+ * data is queued on @sk, sk_ll_usec microseconds passed, or the task
+ * has something better to do.  Returns true if @sk has data to read.
+ */
+bool sk_busy_loop(struct sock *sk, int nonblock)
+{
+	u64 end_time = busy_loop_us_clock() + ACCESS_ONCE(sk->sk_ll_usec);
+	struct napi_struct *napi;
+	bool found;
+	int work;
+
+	rcu_read_lock();
+
+	napi = napi_by_id(sk->sk_napi_id);
+	if (!napi) {
+		rcu_read_unlock();
+		return false;
+	}
+
+	do {
+		work = napi_busy_poll(napi);
+		if (work > 0) {
+			NET_ADD_STATS_USER(sock_net(sk),
+					   LINUX_MIB_BUSYPOLLRXPACKETS, work);
+			sk->sk_ll_stats.rx_packets += work;
+		}
+		found = !skb_queue_empty(&sk->sk_receive_queue);
+	} while (!found && !nonblock && !need_resched() &&
+		 !signal_pending(current) &&
+		 time_before64(busy_loop_us_clock(), end_time));
+
+	rcu_read_unlock();
+
+	if (found) {
+		NET_INC_STATS_USER(sock_net(sk), LINUX_MIB_BUSYPOLLSUCCESS);
+		sk->sk_ll_stats.success++;
+	} else {
+		NET_INC_STATS_USER(sock_net(sk), LINUX_MIB_BUSYPOLLFAIL);
+		sk->sk_ll_stats.fail++;
+	}
+	return found;
+}
+EXPORT_SYMBOL(sk_busy_loop);
+#else
+static inline bool napi_hash_del(struct napi_struct *napi)
+{
+	return false;
+}
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
@@ -3567,6 +3906,10 @@ void netif_napi_del(struct napi_struct *napi)
 	list_del_init(&napi->dev_list);
 	napi_free_frags(napi);
 
+	/* Busy pollers may still look at it */
+	if (napi_hash_del(napi))
+		synchronize_net();
+
 	for (skb = napi->gro_list; skb; skb = next) {
 		next = skb->next;
 		skb->next = NULL;
@@ -5075,6 +5418,9 @@ static void netdev_init_one_queue(struct net_device *dev,
 	spin_lock_init(&queue->_xmit_lock);
 	netdev_set_xmit_lockdep_class(&queue->_xmit_lock, dev->type);
 	queue->xmit_lock_owner = -1;
+#ifdef CONFIG_BQL
+	dql_init(&queue->dql, HZ);
+#endif
 }
 
 static void netdev_init_queues(struct net_device *dev)
@@ -18,6 +18,7 @@
 #include <linux/netdevice.h>
 #include <linux/version.h>
 #include <linux/spinlock.h>
+#include <linux/if_tunnel.h>
 #include <net/protocol.h>
 #include <net/gre.h>
 
@@ -120,9 +121,146 @@ drop:
 	kfree_skb(skb);
 }
 
+/*
+ * GRO and GSO of version 0 GRE.  Only the key flag is accepted, checksums
+ * and sequence numbers would have to be recomputed for every segment when
+ * an aggregate is forwarded and has to be split up again.
+ */
+struct gre_base_hdr {
+	__be16 flags;
+	__be16 protocol;
+};
+#define GRE_HEADER_SECTION 4
+
+static inline unsigned int gre_gro_hdr_len(const struct gre_base_hdr *greh)
+{
+	if (greh->flags & ~GRE_KEY)
+		return 0;
+
+	return greh->flags & GRE_KEY ? 2 * GRE_HEADER_SECTION :
+				       GRE_HEADER_SECTION;
+}
+
+static struct sk_buff *gre_gso_segment(struct sk_buff *skb, int features)
+{
+	struct sk_buff *segs = ERR_PTR(-EINVAL);
+	struct gre_base_hdr *greh;
+	unsigned int grehlen;
+
+	if (unlikely(!(skb_shinfo(skb)->gso_type & SKB_GSO_GRE)))
+		goto out;
+
+	if (unlikely(!pskb_may_pull(skb, sizeof(*greh))))
+		goto out;
+
+	greh = (struct gre_base_hdr *)skb->data;
+	grehlen = gre_gro_hdr_len(greh);
+	if (unlikely(!grehlen || !pskb_may_pull(skb, grehlen)))
+		goto out;
+
+	/* pskb_may_pull() may have moved the header */
+	greh = (struct gre_base_hdr *)skb->data;
+
+	/* Nothing to fix up in the GRE header of the segments, the outer
+	 * IP header is taken care of by inet_gso_segment().
+	 */
+	segs = skb_tunnel_gso_segment(skb, features, grehlen, greh->protocol);
+out:
+	return segs;
+}
+
+static struct sk_buff **gre_gro_receive(struct sk_buff **head,
+					struct sk_buff *skb)
+{
+	struct sk_buff **pp = NULL;
+	struct sk_buff *p;
+	struct gre_base_hdr *greh;
+	struct packet_type *ptype;
+	unsigned int grehlen;
+	unsigned int hlen;
+	unsigned int off;
+	int flush = 1;
+	__wsum csum;
+
+	off = skb_gro_offset(skb);
+	hlen = off + sizeof(*greh);
+	greh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		greh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!greh))
+			goto out;
+	}
+
+	grehlen = gre_gro_hdr_len(greh);
+	if (!grehlen)
+		goto out;
+
+	hlen = off + grehlen;
+	if (skb_gro_header_hard(skb, hlen)) {
+		greh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!greh))
+			goto out;
+	}
+
+	rcu_read_lock();
+	ptype = gro_find_receive_by_type(greh->protocol);
+	if (!ptype)
+		goto out_unlock;
+
+	flush = 0;
+
+	for (p = *head; p; p = p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		/* Same tunnel: same flags, protocol and key */
+		if (memcmp(greh, skb_gro_held_header(p, skb, off), grehlen))
+			NAPI_GRO_CB(p)->same_flow = 0;
+	}
+
+	skb_gro_pull(skb, grehlen);
+
+	csum = skb->csum;
+	skb_postpull_rcsum(skb, greh, grehlen);
+
+	NAPI_GRO_CB(skb)->encap = 1;
+	pp = ptype->gro_receive(head, skb);
+
+	skb->csum = csum;
+
+out_unlock:
+	rcu_read_unlock();
+
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+
+	return pp;
+}
+
+static int gre_gro_complete(struct sk_buff *skb, int nhoff)
+{
+	struct gre_base_hdr *greh = (struct gre_base_hdr *)(skb->data + nhoff);
+	struct packet_type *ptype;
+	int err = -ENOENT;
+
+	rcu_read_lock();
+	ptype = gro_find_complete_by_type(greh->protocol);
+	if (ptype)
+		err = ptype->gro_complete(skb, nhoff + gre_gro_hdr_len(greh));
+	rcu_read_unlock();
+
+	/* after the inner protocol has set its own gso_type */
+	skb_shinfo(skb)->gso_type |= SKB_GSO_GRE;
+
+	return err;
+}
+
 static const struct net_protocol net_gre_protocol = {
 	.handler     = gre_rcv,
 	.err_handler = gre_err,
+	.gso_segment = gre_gso_segment,
+	.gro_receive = gre_gro_receive,
+	.gro_complete = gre_gro_complete,
 	.netns_ok    = 1,
 };
 
@@ -382,8 +382,10 @@ static void unlink_from_pool(struct inet_peer *p)
 	}
 	spin_unlock_bh(&peers.lock);
 
-	if (do_free)
+	if (do_free) {
+		kfree(p->tcp_fastopen);
 		call_rcu_bh(&p->rcu, inetpeer_free_rcu);
+	}
 	else
 		/* The node is used again.  Decrease the reference counter
 		 * back.  The loop "cleanup -> unlink_from_unused
@@ -472,6 +474,7 @@ struct inet_peer *inet_getpeer(__be32 daddr, int create)
 		atomic_set(&p->rid, 0);
 		atomic_set(&p->ip_id_count, secure_ip_id(daddr));
 		p->tcp_ts_stamp = 0;
+		p->tcp_fastopen = NULL;
 		INIT_LIST_HEAD(&p->unused);
 
 
@@ -676,6 +676,10 @@ static int ipgre_rcv(struct sk_buff *skb)
 
 		__skb_tunnel_rx(skb, tunnel->dev);
 
+		/* A GRO aggregate is a plain GSO packet from now on */
+		if (skb_is_gso(skb))
+			skb_shinfo(skb)->gso_type &= ~SKB_GSO_GRE;
+
 		skb_reset_network_header(skb);
 		ipgre_ecn_decapsulate(iph, skb);
 
@@ -0,0 +1,161 @@
+/*
+ * TCP Fast Open: cookie generation and the client cookie cache.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU General Public License
+ *      as published by the Free Software Foundation; either version
+ *      2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/cryptohash.h>
+#include <linux/seqlock.h>
+#include <linux/percpu.h>
+#include <linux/jiffies.h>
+#include <net/tcp.h>
+#include <net/inetpeer.h>
+
+int sysctl_tcp_fastopen __read_mostly = TFO_CLIENT_ENABLE;
+
+/* Server side: the secret the cookies are derived from.  It can be
+ * replaced at run time through the tcp_fastopen_key sysctl, which
+ * invalidates every cookie handed out so far.
+ */
+static u32 tcp_fastopen_key[TCP_FASTOPEN_KEY_LENGTH / sizeof(u32)];
+static DEFINE_SEQLOCK(tcp_fastopen_key_lock);
+
+static DEFINE_PER_CPU(__u32 [16 + SHA_DIGEST_WORDS + SHA_WORKSPACE_WORDS],
+		      tcp_fastopen_scratch);
+
+void __init tcp_fastopen_init(void)
+{
+	get_random_bytes(tcp_fastopen_key, sizeof(tcp_fastopen_key));
+}
+
+void tcp_fastopen_get_key(u32 *key)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqbegin(&tcp_fastopen_key_lock);
+		memcpy(key, tcp_fastopen_key, sizeof(tcp_fastopen_key));
+	} while (read_seqretry(&tcp_fastopen_key_lock, seq));
+}
+
+void tcp_fastopen_set_key(const u32 *key)
+{
+	write_seqlock_bh(&tcp_fastopen_key_lock);
+	memcpy(tcp_fastopen_key, key, sizeof(tcp_fastopen_key));
+	write_sequnlock_bh(&tcp_fastopen_key_lock);
+}
+
+/* Computes the Fast Open cookie for the client address @addr.  The
+ * cookie is a keyed hash of the address only, so a client may reuse
+ * it for any connection to this server until the key changes.
+ *
+ * Called from BH context, under the listener lock.
+ */
+void tcp_fastopen_cookie_gen(__be32 addr, struct tcp_fastopen_cookie *foc)
+{
+	__u32 *tmp = __get_cpu_var(tcp_fastopen_scratch);
+	__u32 *digest = tmp + 16;
+	unsigned int seq;
+
+	memset(tmp, 0, 16 * sizeof(__u32));
+	do {
+		seq = read_seqbegin(&tcp_fastopen_key_lock);
+		memcpy(tmp, tcp_fastopen_key, sizeof(tcp_fastopen_key));
+	} while (read_seqretry(&tcp_fastopen_key_lock, seq));
+	tmp[4] = (__force u32)addr;
+
+	sha_init(digest);
+	sha_transform(digest, (__u8 *)tmp, digest + SHA_DIGEST_WORDS);
+
+	BUILD_BUG_ON(TCP_FASTOPEN_COOKIE_SIZE > SHA_DIGEST_WORDS * sizeof(u32));
+	memcpy(foc->val, digest, TCP_FASTOPEN_COOKIE_SIZE);
+	foc->len = TCP_FASTOPEN_COOKIE_SIZE;
+}
+
+/* Client side: the cookie, MSS and SYN loss history of each server are
+ * kept in its inet_peer entry, so the cache is limited to IPv4 peers.
+ * The entries are tiny and rarely written, a single seqlock covers all.
+ */
+static DEFINE_SEQLOCK(tcp_fastopen_cache_lock);
+
+void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+			    struct tcp_fastopen_cookie *cookie,
+			    int *syn_loss, unsigned long *last_syn_loss)
+{
+	struct inet_peer_fastopen *tfo;
+	struct inet_peer *peer;
+	unsigned int seq;
+
+	cookie->len = -1;
+	*syn_loss = 0;
+	if (sk->sk_family != AF_INET)
+		return;
+
+	peer = inet_getpeer(inet_sk(sk)->inet_daddr, 1);
+	if (!peer)
+		return;
+
+	do {
+		seq = read_seqbegin(&tcp_fastopen_cache_lock);
+		tfo = peer->tcp_fastopen;
+		if (!tfo)
+			continue;
+		if (tfo->mss)
+			*mss = tfo->mss;
+		cookie->len = tfo->cookie_len;
+		if (cookie->len > 0)
+			memcpy(cookie->val, tfo->cookie, cookie->len);
+		*syn_loss = tfo->syn_loss;
+		*last_syn_loss = *syn_loss ? tfo->last_syn_loss : 0;
+	} while (read_seqretry(&tcp_fastopen_cache_lock, seq));
+
+	inet_putpeer(peer);
+}
+
+void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+			    struct tcp_fastopen_cookie *cookie, bool syn_lost)
+{
+	struct inet_peer_fastopen *tfo;
+	struct inet_peer *peer;
+
+	if (sk->sk_family != AF_INET)
+		return;
+
+	peer = inet_getpeer(inet_sk(sk)->inet_daddr, 1);
+	if (!peer)
+		return;
+
+	write_seqlock_bh(&tcp_fastopen_cache_lock);
+	tfo = peer->tcp_fastopen;
+	if (!tfo) {
+		/* Stays attached until the inet_peer entry is freed */
+		tfo = kzalloc(sizeof(*tfo), GFP_ATOMIC);
+		if (!tfo)
+			goto out;
+		tfo->cookie_len = -1;
+		peer->tcp_fastopen = tfo;
+	}
+	if (mss)
+		tfo->mss = mss;
+	if (cookie->len > 0 && cookie->len <= TCP_FASTOPEN_COOKIE_MAX) {
+		tfo->cookie_len = cookie->len;
+		memcpy(tfo->cookie, cookie->val, cookie->len);
+	}
+	if (syn_lost) {
+		if (tfo->syn_loss < 255)
+			tfo->syn_loss++;
+		tfo->last_syn_loss = jiffies;
+	} else {
+		tfo->syn_loss = 0;
+	}
+out:
+	write_sequnlock_bh(&tcp_fastopen_cache_lock);
+
+	inet_putpeer(peer);
+}
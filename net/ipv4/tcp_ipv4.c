@@ -72,6 +72,7 @@
 #include <net/timewait_sock.h>
 #include <net/xfrm.h>
 #include <net/netdma.h>
+#include <net/busy_poll.h>
 
 #include <linux/inet.h>
 #include <linux/ipv6.h>
@@ -1216,10 +1217,152 @@ static struct timewait_sock_ops tcp_timewait_sock_ops = {
 	.twsk_destructor= tcp_twsk_destructor,
 };
 
+/* Decides whether the SYN @skb may open a Fast Open child right away.
+ * @valid_foc is set to the cookie the SYN-ACK should carry, if any.
+ */
+static bool tcp_fastopen_check(struct sock *sk, struct sk_buff *skb,
+			       struct tcp_fastopen_cookie *foc,
+			       struct tcp_fastopen_cookie *valid_foc)
+{
+	bool syn_data = skb->len > tcp_hdrlen(skb);
+	int max_qlen = tcp_sk(sk)->fastopen_qlen;
+
+	if (!max_qlen && (sysctl_tcp_fastopen & TFO_SERVER_WO_SOCKOPT1))
+		max_qlen = sk->sk_max_ack_backlog;
+	if (!(sysctl_tcp_fastopen & TFO_SERVER_ENABLE) || !max_qlen)
+		return false;
+
+	if (foc->len < 0) {
+		/* No (valid) cookie option at all */
+		if (!syn_data ||
+		    !(sysctl_tcp_fastopen & TFO_SERVER_COOKIE_NOT_REQD))
+			return false;
+	} else {
+		tcp_fastopen_cookie_gen(ip_hdr(skb)->saddr, valid_foc);
+		if (foc->len == 0) {
+			NET_INC_STATS_BH(sock_net(sk),
+					 LINUX_MIB_TCPFASTOPENCOOKIEREQD);
+			return false;
+		}
+		/* A stale or forged cookie gets the valid one back */
+		if (foc->len != valid_foc->len ||
+		    memcmp(foc->val, valid_foc->val, foc->len))
+			return false;
+		valid_foc->len = -1;
+	}
+
+	/* A FIN in the SYN is left for the regular handshake */
+	if (tcp_hdr(skb)->fin)
+		return false;
+
+	/* Only unaccepted children are counted against the limit */
+	if (sk->sk_ack_backlog >= max_qlen) {
+		NET_INC_STATS_BH(sock_net(sk),
+				 LINUX_MIB_TCPFASTOPENLISTENOVERFLOW);
+		return false;
+	}
+	return true;
+}
+
+/* Creates the child of a Fast Open SYN right away, with the SYN data
+ * queued for reading, and sends the SYN-ACK acknowledging them.  The
+ * child keeps @req to retransmit the SYN-ACK until the handshake
+ * completes; another request sock stands for it in the accept queue,
+ * as accept() frees that one.
+ *
+ * Returns false if a regular handshake should be done instead.  @dst
+ * is consumed either way.
+ */
+static bool tcp_v4_conn_req_fastopen(struct sock *sk, struct sk_buff *skb,
+				     struct request_sock *req,
+				     struct dst_entry *dst,
+				     struct request_values *rvp)
+{
+	const struct inet_request_sock *ireq = inet_rsk(req);
+	u32 data_len = skb->len - tcp_hdrlen(skb);
+	struct request_sock *token;
+	struct sk_buff *skb_synack;
+	struct tcp_sock *tp;
+	struct sock *child;
+
+	if (!dst && (dst = inet_csk_route_req(sk, req)) == NULL)
+		goto fail;
+
+	token = inet_reqsk_alloc(&tcp_request_sock_ops);
+	if (token == NULL)
+		goto fail_dst;
+
+	/* The SYN-ACK and the child acknowledge the data.  The SYN-ACK
+	 * is built first, it sets up the window the child inherits.
+	 */
+	tcp_rsk(req)->rcv_isn += data_len;
+	skb_synack = tcp_make_synack(sk, dst, req, rvp);
+	if (skb_synack == NULL)
+		goto fail_token;
+
+	child = inet_csk(sk)->icsk_af_ops->syn_recv_sock(sk, skb, req, dst);
+	if (child == NULL) {
+		kfree_skb(skb_synack);
+		dst = NULL;
+		goto fail_token;
+	}
+
+	/* Should it get lost, the child retransmits it on its timer */
+	__tcp_v4_send_check(skb_synack, ireq->loc_addr, ireq->rmt_addr);
+	ip_build_and_send_pkt(skb_synack, sk, ireq->loc_addr, ireq->rmt_addr,
+			      inet_sk(child)->opt);
+
+	tp = tcp_sk(child);
+	tp->fastopen_rsk = req;
+
+	/* RFC1323: The window in SYN & SYN/ACK segments is never scaled. */
+	tp->snd_wnd = ntohs(tcp_hdr(skb)->window);
+	tp->max_window = tp->snd_wnd;
+
+	/* The SYN data are read from their start, tcp_recvmsg() skips the
+	 * SYN flag of the queued skb.
+	 */
+	tp->copied_seq = TCP_SKB_CB(skb)->seq + 1;
+
+	tcp_finish_passive_open(child);
+
+	if (data_len) {
+		/* The caller frees the skb, take a reference */
+		skb = skb_get(skb);
+		skb_dst_drop(skb);
+		__skb_pull(skb, tcp_hdrlen(skb));
+		skb_set_owner_r(skb, child);
+		__skb_queue_tail(&child->sk_receive_queue, skb);
+		tp->syn_data_acked = 1;
+	}
+
+	inet_csk_reset_xmit_timer(child, ICSK_TIME_RETRANS,
+				  TCP_TIMEOUT_INIT, TCP_RTO_MAX);
+
+	inet_csk_reqsk_queue_add(sk, token, child);
+	sk->sk_data_ready(sk, 0);
+
+	bh_unlock_sock(child);
+	sock_put(child);
+	NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVE);
+	return true;
+
+fail_token:
+	tcp_rsk(req)->rcv_isn -= data_len;
+	__reqsk_free(token);
+fail_dst:
+	dst_release(dst);
+fail:
+	NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVEFAIL);
+	return false;
+}
+
 int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 {
 	struct tcp_extend_values tmp_ext;
 	struct tcp_options_received tmp_opt;
+	struct tcp_fastopen_cookie foc = { .len = -1 };
+	struct tcp_fastopen_cookie valid_foc = { .len = -1 };
 	u8 *hash_location;
 	struct request_sock *req;
 	struct inet_request_sock *ireq;
@@ -1272,7 +1415,7 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	tcp_clear_options(&tmp_opt);
 	tmp_opt.mss_clamp = TCP_MSS_DEFAULT;
 	tmp_opt.user_mss  = tp->rx_opt.user_mss;
-	tcp_parse_options(skb, &tmp_opt, &hash_location, 0);
+	tcp_parse_options(skb, &tmp_opt, &hash_location, 0, &foc);
 
 	if (tmp_opt.cookie_plus > 0 &&
 	    tmp_opt.saw_tstamp &&
@@ -1309,6 +1452,7 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 		goto drop_and_release;
 	}
 	tmp_ext.cookie_in_always = tp->rx_opt.cookie_in_always;
+	tmp_ext.fastopen_cookie = NULL;
 
 	if (want_cookie && !tmp_opt.saw_tstamp)
 		tcp_clear_options(&tmp_opt);
@@ -1378,6 +1522,15 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	}
 	tcp_rsk(req)->snt_isn = isn;
 
+	if (!want_cookie && tcp_fastopen_check(sk, skb, &foc, &valid_foc)) {
+		if (tcp_v4_conn_req_fastopen(sk, skb, req, dst,
+					     (struct request_values *)&tmp_ext))
+			return 0;
+		dst = NULL;
+	}
+	if (valid_foc.len > 0)
+		tmp_ext.fastopen_cookie = &valid_foc;
+
 	if (tcp_v4_send_synack(sk, dst, req,
 			       (struct request_values *)&tmp_ext) ||
 	    want_cookie)
@@ -1680,6 +1833,7 @@ process:
 	if (sk_filter(sk, skb))
 		goto discard_and_relse;
 
+	sk_mark_napi_id(sk, skb);
 	skb->dev = NULL;
 
 	bh_lock_sock_nested(sk);
@@ -1743,6 +1897,7 @@ do_time_wait:
 	case TCP_TW_SYN: {
 		struct sock *sk2 = inet_lookup_listener(dev_net(skb->dev),
 							&tcp_hashinfo,
+							iph->saddr, th->source,
 							iph->daddr, th->dest,
 							inet_iif(skb));
 		if (sk2) {
@@ -1967,6 +2122,10 @@ void tcp_v4_destroy_sock(struct sock *sk)
 		tp->cookie_values = NULL;
 	}
 
+	/* TCP Fast Open */
+	tcp_free_fastopen_req(tp);
+	tcp_fastopen_rsk_release(sk);
+
 	percpu_counter_dec(&tcp_sockets_allocated);
 }
 EXPORT_SYMBOL(tcp_v4_destroy_sock);
@@ -2558,17 +2717,30 @@ void tcp4_proc_exit(void)
 struct sk_buff **tcp4_gro_receive(struct sk_buff **head, struct sk_buff *skb)
 {
 	struct iphdr *iph = skb_gro_network_header(skb);
+	__wsum csum = skb->csum;
 
 	switch (skb->ip_summed) {
+	case CHECKSUM_NONE:
+		/* Devices do not verify the inner packet of a tunnel.
+		 * Doing it here costs no more than leaving it to the
+		 * stack, and lets the flow be aggregated.  Anything
+		 * else the device left unchecked is not worth it.
+		 */
+		if (!NAPI_GRO_CB(skb)->encap)
+			goto flush;
+
+		csum = skb_checksum(skb, skb_gro_offset(skb),
+				    skb_gro_len(skb), 0);
+
+		/* fall through */
 	case CHECKSUM_COMPLETE:
 		if (!tcp_v4_check(skb_gro_len(skb), iph->saddr, iph->daddr,
-				  skb->csum)) {
+				  csum)) {
 			skb->ip_summed = CHECKSUM_UNNECESSARY;
 			break;
 		}
 
-		/* fall through */
-	case CHECKSUM_NONE:
+flush:
 		NAPI_GRO_CB(skb)->flush = 1;
 		return NULL;
 	}
@@ -2576,12 +2748,12 @@ struct sk_buff **tcp4_gro_receive(struct sk_buff **head, struct sk_buff *skb)
 	return tcp_gro_receive(head, skb);
 }
 
-int tcp4_gro_complete(struct sk_buff *skb)
+int tcp4_gro_complete(struct sk_buff *skb, int thoff)
 {
 	struct iphdr *iph = ip_hdr(skb);
 	struct tcphdr *th = tcp_hdr(skb);
 
-	th->check = ~tcp_v4_check(skb->len - skb_transport_offset(skb),
+	th->check = ~tcp_v4_check(skb->len - thoff,
 				  iph->saddr, iph->daddr, 0);
 	skb_shinfo(skb)->gso_type = SKB_GSO_TCPV4;
 
@@ -2605,6 +2777,7 @@ struct proto tcp_prot = {
 	.sendmsg		= tcp_sendmsg,
 	.sendpage		= tcp_sendpage,
 	.backlog_rcv		= tcp_v4_do_rcv,
+	.release_cb		= tcp_release_cb,
 	.hash			= inet_hash,
 	.unhash			= inet_unhash,
 	.get_port		= inet_csk_get_port,
@@ -1554,6 +1554,67 @@ out:
 }
 
 
+/*
+ *	Small writes to a peer that has not drained its queue yet get a
+ *	buffer of this size, so that the writes after them can be appended
+ *	to it by unix_stream_append() instead of each taking an skb.
+ */
+#define UNIX_STREAM_COALESCE_SIZE	SKB_WITH_OVERHEAD(2048)
+
+/*
+ *	Append up to len bytes of msg to the skb at the tail of the peer's
+ *	receive queue.  That skb was queued (and the reader woken) by an
+ *	earlier send of ours, so no new skb, state lock or wakeup is needed.
+ *	Holding the reader's readlock keeps recvmsg from consuming the skb
+ *	while we fill its tailroom; if the reader is busy we don't wait.
+ *	Returns the number of bytes appended, which may be 0.
+ */
+static int unix_stream_append(struct sock *sk, struct sock *other,
+			      struct scm_cookie *scm, struct msghdr *msg,
+			      int len)
+{
+	struct sk_buff_head *queue = &other->sk_receive_queue;
+	struct unix_sock *u = unix_sk(other);
+	struct sk_buff *skb;
+	unsigned long flags;
+	int size = 0;
+	int err;
+
+	if (!mutex_trylock(&u->readlock))
+		return 0;
+
+	spin_lock_irqsave(&queue->lock, flags);
+	skb = skb_peek_tail(queue);
+	if (skb && skb->sk == sk && !UNIXCB(skb).fp &&
+	    UNIXCB(skb).pid == scm->pid && UNIXCB(skb).cred == scm->cred &&
+	    !sock_flag(other, SOCK_DEAD) &&
+	    !(other->sk_shutdown & RCV_SHUTDOWN)) {
+		size = min_t(int, len, skb_tailroom(skb));
+		/* unix_release_sock() purges the queue without readlock */
+		if (size > 0)
+			skb_get(skb);
+	}
+	spin_unlock_irqrestore(&queue->lock, flags);
+
+	if (size <= 0) {
+		size = 0;
+		goto out;
+	}
+
+	err = memcpy_fromiovec(skb_tail_pointer(skb), msg->msg_iov, size);
+	if (!err) {
+		spin_lock_irqsave(&queue->lock, flags);
+		skb_put(skb, size);
+		spin_unlock_irqrestore(&queue->lock, flags);
+	} else {
+		size = err;
+	}
+	kfree_skb(skb);
+out:
+	mutex_unlock(&u->readlock);
+	return size;
+}
+
 static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 			       struct msghdr *msg, size_t len)
 {
@@ -1561,11 +1622,12 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	struct sock *sk = sock->sk;
 	struct sock *other = NULL;
 	struct sockaddr_un *sunaddr = msg->msg_name;
-	int err, size;
+	int err, size, alloc;
 	struct sk_buff *skb;
 	int sent = 0;
 	struct scm_cookie tmp_scm;
 	bool fds_sent = false;
+	bool wake;
 	int max_level;
 
 	if (NULL == siocb->scm)
@@ -1593,6 +1655,17 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	if (sk->sk_shutdown & SEND_SHUTDOWN)
 		goto pipe_err;
 
+	/*
+	 *	If the reader is behind, the start of the message may fit in
+	 *	the buffer it has yet to read.
+	 */
+	if (!siocb->scm->fp && !skb_queue_empty(&other->sk_receive_queue)) {
+		err = unix_stream_append(sk, other, siocb->scm, msg, len);
+		if (err < 0)
+			goto out_err;
+		sent = err;
+	}
+
 	while (sent < len) {
 		/*
 		 *	Optimisation for the fact that under 0.01% of X
@@ -1608,11 +1681,17 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		if (size > SKB_MAX_ALLOC)
 			size = SKB_MAX_ALLOC;
 
+		/* Leave room for the next small writes to be appended */
+		alloc = size;
+		if (size < UNIX_STREAM_COALESCE_SIZE && !siocb->scm->fp &&
+		    !skb_queue_empty(&other->sk_receive_queue))
+			alloc = UNIX_STREAM_COALESCE_SIZE;
+
 		/*
 		 *	Grab a buffer
 		 */
 
-		skb = sock_alloc_send_skb(sk, size, msg->msg_flags&MSG_DONTWAIT,
+		skb = sock_alloc_send_skb(sk, alloc, msg->msg_flags&MSG_DONTWAIT,
 					  &err);
 
 		if (skb == NULL)
@@ -1649,11 +1728,18 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		    (other->sk_shutdown & RCV_SHUTDOWN))
 			goto pipe_err_free;
 
+		/*
+		 * A reader only sleeps on an empty queue, so if data is
+		 * already waiting it was woken for that and will get to
+		 * ours without another wakeup.
+		 */
+		wake = skb_queue_empty(&other->sk_receive_queue);
 		skb_queue_tail(&other->sk_receive_queue, skb);
 		if (max_level > unix_sk(other)->recursion_level)
 			unix_sk(other)->recursion_level = max_level;
 		unix_state_unlock(other);
-		other->sk_data_ready(other, size);
+		if (wake)
+			other->sk_data_ready(other, size);
 		sent += size;
 	}
 
@@ -0,0 +1,197 @@
+/*
+ *
+ * sched-unix.c
+ *
+ * unix: Benchmark for AF_UNIX stream sockets
+ *
+ * One process writes messages of a fixed size into a socketpair(),
+ * another one reads them.  Repeated for each message size from 64B
+ * up to 64KB, or just for the size given with --size.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#define MIN_MSG_SIZE	64
+#define MAX_MSG_SIZE	65536
+
+static const char *total_str = "64MB";
+static const char *size_str = NULL;
+
+static const struct option options[] = {
+	OPT_STRING('t', "total", &total_str, "64MB",
+		    "Specify amount of data to transfer for each size"),
+	OPT_STRING('s', "size", &size_str, "64..64KB",
+		    "Specify a single message size"),
+	OPT_END()
+};
+
+static const char * const bench_sched_unix_usage[] = {
+	"perf bench sched unix <options>",
+	NULL
+};
+
+static void reader(int fd, unsigned long long total)
+{
+	char buf[MAX_MSG_SIZE];
+	ssize_t ret;
+
+	while (total) {
+		ret = read(fd, buf, sizeof(buf));
+		if (ret <= 0) {
+			if (ret < 0 && errno == EINTR)
+				continue;
+			fprintf(stderr, "read failed: %s\n",
+				ret ? strerror(errno) : "EOF");
+			exit(1);
+		}
+		total -= ret;
+	}
+	exit(0);
+}
+
+static void writer(int fd, const char *buf, size_t size,
+		   unsigned long long msgs)
+{
+	unsigned long long i;
+	ssize_t ret;
+	size_t done;
+
+	for (i = 0; i < msgs; i++) {
+		for (done = 0; done < size; done += ret) {
+			ret = write(fd, buf + done, size - done);
+			if (ret < 0) {
+				if (errno == EINTR) {
+					ret = 0;
+					continue;
+				}
+				fprintf(stderr, "write failed: %s\n",
+					strerror(errno));
+				exit(1);
+			}
+		}
+	}
+}
+
+/* Stores in @diff the time it took the reader to get all the data */
+static void run_one(size_t size, unsigned long long msgs,
+		    struct timeval *diff)
+{
+	static char buf[MAX_MSG_SIZE];
+	struct timeval start, stop;
+	int fds[2], wait_stat;
+	pid_t pid, retpid;
+
+	assert(!socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+	/* don't let the child print our buffered output again */
+	fflush(stdout);
+	pid = fork();
+	assert(pid >= 0);
+
+	if (!pid) {
+		close(fds[0]);
+		reader(fds[1], msgs * size);
+	}
+	close(fds[1]);
+
+	gettimeofday(&start, NULL);
+	writer(fds[0], buf, size, msgs);
+	retpid = waitpid(pid, &wait_stat, 0);
+	gettimeofday(&stop, NULL);
+
+	assert((retpid == pid) && WIFEXITED(wait_stat) &&
+	       !WEXITSTATUS(wait_stat));
+	close(fds[0]);
+
+	timersub(&stop, &start, diff);
+}
+
+static void print_result(size_t size, unsigned long long msgs,
+			 struct timeval *diff)
+{
+	double secs = diff->tv_sec + diff->tv_usec / 1000000.0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %8lu %8lu.%03lu %14.0lf %12.2lf\n",
+		       (unsigned long)size, diff->tv_sec,
+		       (unsigned long)(diff->tv_usec / 1000),
+		       (double)msgs / secs,
+		       (double)msgs * size / secs / (1024 * 1024));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu %lu.%03lu\n", (unsigned long)size, diff->tv_sec,
+		       (unsigned long)(diff->tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+int bench_sched_unix(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	unsigned long long total, msgs;
+	size_t size, min_size = MIN_MSG_SIZE, max_size = MAX_MSG_SIZE;
+	struct timeval diff;
+	s64 val;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_unix_usage, 0);
+
+	val = perf_atoll((char *)total_str);
+	if (val <= 0) {
+		fprintf(stderr, "Invalid total: %s\n", total_str);
+		return 1;
+	}
+	total = val;
+
+	if (size_str) {
+		val = perf_atoll((char *)size_str);
+		if (val <= 0 || val > MAX_MSG_SIZE) {
+			fprintf(stderr, "Invalid size: %s (max %d)\n",
+				size_str, MAX_MSG_SIZE);
+			return 1;
+		}
+		min_size = max_size = val;
+	}
+
+	if (bench_format == BENCH_FORMAT_DEFAULT) {
+		printf("# Transferring %llu bytes over a unix socketpair() "
+		       "for each message size\n\n", total);
+		printf(" %8s %12s %14s %12s\n",
+		       "size", "time [sec]", "msgs/sec", "MB/sec");
+	}
+
+	for (size = min_size; size <= max_size; size *= 2) {
+		msgs = total / size;
+		if (!msgs)
+			msgs = 1;
+		run_one(size, msgs, &diff);
+		print_result(size, msgs, &diff);
+	}
+
+	return 0;
+}
@@ -42,6 +42,9 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "unix",
+	  "Stream of messages of 64B..64KB over an AF_UNIX socketpair()",
+	  bench_sched_unix      },
 	suite_all,
 	{ NULL,
 	  NULL,